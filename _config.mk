@@ -11,6 +11,10 @@ cxx=g++ # <--- GNU C++ compiler
 flags=-std=c++11 -Wall -Wextra -pedantic -O3 # <--- GNU compiler flags
 #cflags=-std=c++11 -Wall -O3 # <--- Intel compiler flags
 
+#mixed precision storage of thermal diagnostics (floats and byte fractions),
+#uncomment to enable, the prognostic variables are always double precision
+#prec=-DMIXED_PRECISION
+
 #compilation flag for openmp
 omp=-fopenmp
 #omp=-qopenmp
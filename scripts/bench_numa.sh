@@ -0,0 +1,47 @@
+: '
+This script measures how the model scales from one socket to two. It runs
+a short trial with the threads bound to the first socket only, then with
+the same number of threads spread over both sockets, for several thread
+counts. The average time per step is converted into an effective memory
+bandwidth using the number of column arrays streamed per step, which is
+roughly 21 arrays of Nz doubles per thermal column (8 per evaluation of the
+time derivatives, two evaluations per step, plus the solver updates). If
+first-touch placement works, the two socket runs should reach close to
+double the bandwidth of the one socket runs at the same per-socket thread
+count. The model has to be compiled and grid files must exist before
+running this script. This script can only run in the top bous-therm
+directory.
+'
+
+#inputs
+griddir=${1:?"first argument must be the grid directory"}
+settings=${2:?"second argument must be a settings file for a short trial"}
+threads=${3:-"1 2 4 8 16"}
+
+#scratch output directory
+outdir=$(mktemp -d)
+
+#grid size
+Nx=$(cat ${griddir}/Nx.txt)
+Nz=$(cat ${griddir}/Nz.txt)
+Ny=1
+if [ -f ${griddir}/Ny.txt ]; then Ny=$(cat ${griddir}/Ny.txt); fi
+Ncol=$(( Ny*(Nx + 1) ))
+
+echo "sockets threads sec/step GB/s"
+for nsock in 1 2; do
+  for n in $threads; do
+    #all places on one socket, or threads spread across two
+    export OMP_NUM_THREADS=$n
+    export OMP_PLACES="sockets(${nsock})"
+    export OMP_PROC_BIND=spread
+    #run the model and pull out the last reported time per step
+    tstep=$(./bin/bous_therm.exe $griddir $settings $outdir \
+            | grep "average time per step" | tail -1 | awk '{print $(NF-1)}')
+    awk -v s=$nsock -v n=$n -v t=$tstep -v c=$Ncol -v z=$Nz \
+        'BEGIN {printf("%7d %7d %8.3g %5.2f\n", s, n, t, 21*8*c*z/t/1e9)}'
+  done
+done
+
+#clean up
+rm -r $outdir
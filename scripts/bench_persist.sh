@@ -0,0 +1,38 @@
+: '
+This script compares the default time loop, where every evaluation of the
+time derivatives starts a new team of threads, with the persistent thread
+team of the "persist" setting, where one parallel region spans the whole
+run and the threads meet at barriers. It runs the same short trial both ways
+for several thread counts and prints the average time per step of each and
+their ratio. The fork and join overhead matters most for small grids (a few
+hundred columns) and many threads. The model has to be compiled and grid
+files must exist before running this script. The settings file should not
+set "persist" itself. This script can only run in the top bous-therm
+directory.
+'
+
+#inputs
+griddir=${1:?"first argument must be the grid directory"}
+settings=${2:?"second argument must be a settings file for a short trial"}
+threads=${3:-"1 2 4 8 16 32"}
+
+#scratch output directory and settings files
+outdir=$(mktemp -d)
+cp $settings ${outdir}/persist0.txt
+cp $settings ${outdir}/persist1.txt
+echo "persist = 1" >> ${outdir}/persist1.txt
+
+echo "threads  default  persist  speedup"
+for n in $threads; do
+  export OMP_NUM_THREADS=$n
+  #run the model both ways and pull out the last reported time per step
+  t0=$(./bin/bous_therm.exe $griddir ${outdir}/persist0.txt $outdir \
+       | grep "average time per step" | tail -1 | awk '{print $(NF-1)}')
+  t1=$(./bin/bous_therm.exe $griddir ${outdir}/persist1.txt $outdir \
+       | grep "average time per step" | tail -1 | awk '{print $(NF-1)}')
+  awk -v n=$n -v a=$t0 -v b=$t1 \
+      'BEGIN {printf("%7d %8.3g %8.3g %8.2f\n", n, a, b, a/b)}'
+done
+
+#clean up
+rm -r $outdir
@@ -34,6 +34,89 @@ def tonum(x):
 #read a binary file from a directory (assuming float64 format)
 join_read = lambda dirname, var: fromfile(join(dirname, var))
 
+def read_dtypes(tdir):
+    """read the data type tags of snapped fields written by the model, if any
+    args:
+        tdir - output directory
+    returns:
+        dtypes - dictionary of field name and data type tag"""
+
+    dtypes = {}
+    fn = join(tdir, 'dtypes.txt')
+    if isfile(fn):
+        with open(fn, 'r') as ifile:
+            for line in ifile.readlines():
+                if '=' in line:
+                    k, v = line.split('=')
+                    dtypes[k.strip()] = v.strip()
+    return(dtypes)
+
+def read_tagged(fn, tag='float64'):
+    """read a binary file with a data type tag written by the model
+    args:
+        fn - path to file
+    optional args:
+        tag - data type tag, 'uint8frac' is a fraction stored in 1/255 steps
+    returns:
+        a - float64 array"""
+
+    if tag == 'uint8frac':
+        return(fromfile(fn, dtype='uint8')/255.0)
+    return(fromfile(fn, dtype=tag).astype('float64'))
+
+def bytes_tagged(raw, tag='float64'):
+    """convert the raw bytes of a field into a float64 array
+    args:
+        raw - uint8 array
+    optional args:
+        tag - data type tag, as in read_tagged
+    returns:
+        a - float64 array"""
+
+    if tag == 'uint8frac':
+        return(raw/255.0)
+    return(raw.view(tag).astype('float64'))
+
+def read_delta(fn, ref=None):
+    """read a snap file written with delta encoding (the snapdelta setting),
+    which is the XOR of the field's bytes with its previous snap, shuffled into
+    byte planes and run length coded (see delta_encode in bous_therm_io.h)
+    args:
+        fn - path to file
+    optional args:
+        ref - uint8 array of the previous snap of the field, unless the file
+              is a key written by itself
+    returns:
+        raw - uint8 array of the field's bytes, or None if the file isn't
+              delta encoded"""
+
+    b = fromfile(fn, dtype='uint8')
+    if b[:8].tobytes() != b'BTDELTA1':
+        return(None)
+    w, key = [int(i) for i in b[8:16].view('uint32')]
+    n, nenc = [int(i) for i in b[16:32].view('uint64')]
+    enc = b[32:32+nenc].tobytes()
+    #undo the run length coding
+    x = bytearray()
+    i = 0
+    while i < nenc:
+        c = enc[i]
+        if c < 128:
+            x += enc[i+1:i+2+c]
+            i += c + 2
+        else:
+            x += enc[i+1:i+2]*(c - 125)
+            i += 2
+    if len(x) != n*w:
+        raise ValueError('delta encoded file %s is corrupt' % fn)
+    #unshuffle the byte planes and undo the XOR
+    raw = frombuffer(bytes(x), dtype='uint8').reshape(w, n).T.reshape(-1)
+    if not key:
+        if ref is None or len(ref) != n*w:
+            raise ValueError('the previous snap of %s is missing' % fn)
+        raw = raw ^ ref
+    return(raw)
+
 def read_grid_num(gdir, fn, dtype=int):
     """read a text file containing a single number from the grid dir
     args:
@@ -61,8 +144,17 @@ def read_snaps(tdir, snapname, reshape=None, transpose=False):
     fns = [fn for fn in fns if ('_'.join(fn.split('_')[:-1]) == snapname)]
     #sort by the last digit
     fns = sorted(fns, key=lambda fn: int(fn.split('_')[-1]))
-    #get arrays for snaps, in order
-    snaps = [fromfile(join(tdir, fn)) for fn in fns]
+    #get arrays for snaps, in order, at whatever precision they were written,
+    #decoding each delta encoded snap from the one before
+    tag = read_dtypes(tdir).get(snapname, 'float64')
+    snaps, ref = [], None
+    for fn in fns:
+        raw = read_delta(join(tdir, fn), ref)
+        if raw is None:
+            snaps.append(read_tagged(join(tdir, fn), tag))
+        else:
+            snaps.append(bytes_tagged(raw, tag))
+            ref = raw
     #reformat if desired
     if reshape is not None:
         snaps = [s.reshape(reshape) for s in snaps]
@@ -78,8 +170,10 @@ def read_T_H_snaps(tdir, gdir):
         tdir - output directory
         gdir - grid directory
     returns:
-        T - 3d array of temperature snaps
-        H - 2d array of water table snaps"""
+        T - temperature snaps, each shaped (Nz, Nx+1), or (Ny, Nz, Nx+1) for
+            map-view grids
+        H - water table snaps, each shaped (Nx,), or (Ny, Nx) for map-view
+            grids"""
 
     #get file names for snaps
     fns = os.listdir(tdir)
@@ -93,12 +187,78 @@ def read_T_H_snaps(tdir, gdir):
     #get size of grids
     Nx = read_grid_num(gdir, 'Nx', int)
     Nz = read_grid_num(gdir, 'Nz', int)
+    #map-view grids have rows, transects don't
+    if isfile(join(gdir, 'Ny.txt')):
+        Ny = read_grid_num(gdir, 'Ny', int)
+        H = [s[:Ny*Nx].reshape(Ny,Nx) for s in snaps]
+        T = [s[Ny*Nx:].reshape(Ny,Nx+1,Nz).transpose(0,2,1) for s in snaps]
+        return(T, H)
     #slice the snaps
     H = [s[:Nx] for s in snaps]
     T = [s[Nx:].reshape(Nx+1,Nz).T for s in snaps]
 
     return(T, H)
 
+def read_stats(tdir):
+    """read the in-situ statistics written by the model with stats = 1
+    args:
+        tdir - output directory
+    returns:
+        stats - dictionary of statistics arrays, with the depth histogram
+                'Hdep' shaped (cells, bins), or an empty dictionary if there
+                aren't any"""
+
+    stats = {}
+    if not isfile(join(tdir, 'stat_t')):
+        return(stats)
+    for name in ['t', 'evap', 'minaqbot', 'maxaqbot', 'thaw', 'qH', 'Hdepbins']:
+        stats[name] = join_read(tdir, 'stat_' + name)
+    nbin = len(stats['Hdepbins']) - 1
+    stats['Hdep'] = join_read(tdir, 'stat_Hdep').reshape(-1, nbin)
+    return(stats)
+
+def read_probes(tdir):
+    """read the probe records written by the model with the probes setting
+    args:
+        tdir - output directory
+    returns:
+        probes - dictionary with the record times 't', the probe locations
+                 'location' as written in the settings, and arrays 'T', 'H',
+                 'qH', 'Kint', 'aqbot', and 'evap' shaped (records, probes),
+                 or an empty dictionary if there aren't any"""
+
+    probes = {}
+    fn = join(tdir, 'probes.txt')
+    if not isfile(fn):
+        return(probes)
+    with open(fn, 'r') as ifile:
+        loc = [line.split()[1] for line in ifile.readlines() if line[0] != '#']
+    names = ['T', 'H', 'qH', 'Kint', 'aqbot', 'evap']
+    rec = join_read(tdir, 'probes').reshape(-1, 1 + len(names)*len(loc))
+    probes['t'] = rec[:,0]
+    probes['location'] = loc
+    for i,name in enumerate(names):
+        probes[name] = rec[:,1+i::len(names)]
+    return(probes)
+
+def read_events(tdir):
+    """read the events found by the model with the events setting
+    args:
+        tdir - output directory
+    returns:
+        events - DataFrame with the name, direction, time, and step of each
+                 event, or None if there aren't any
+        snaps - list of the solutions at the events, where they were written"""
+
+    fn = join(tdir, 'events.txt')
+    if not isfile(fn):
+        return(None, [])
+    events = pd.read_csv(fn, sep=' ', comment='#', header=None,
+            names=['name', 'direction', 'time', 'step'], index_col=0)
+    snaps = [join_read(tdir, 'event_snap_%d' % i) for i in events.index
+            if isfile(join(tdir, 'event_snap_%d' % i))]
+    return(events, snaps)
+
 def read_settings(fn):
     """read the values of a settings file into a dictionary
     args:
@@ -243,3 +403,108 @@ class Evap:
     @property
     def frozen(self):
         return( ~self.thawed )
+
+class Store:
+    """a columnar store of a batch of trials written by
+    ./bin/collect_trials.exe (see src/bous_therm_store.h), with the columns
+    mapped into memory as they're used
+    args:
+        sdir - store directory"""
+
+    def __init__(self, sdir):
+
+        self.sdir = sdir
+        self.columns = {}
+        self.varying = []
+        with open(join(sdir, 'schema.txt'), 'r') as ifile:
+            for line in ifile.readlines():
+                w = line.split()
+                if (not w) or (w[0][0] == '#'):
+                    continue
+                if w[0] == 'column':
+                    self.columns[w[1]] = tuple(w[2:5])
+                elif w[0] == 'varying':
+                    self.varying = w[1:]
+                else:
+                    setattr(self, w[0], int(w[1]))
+        self._maps = {}
+        self.offsets = self._map('ser_offsets.i64', int64)
+        #minimum and maximum of the numeric setting and summary columns in each chunk
+        self._zone = [k for k,(kind,typ,_) in self.columns.items()
+                if kind in ('setting', 'summary') and typ != 'str']
+        self.zones = self._map('chunks.f64', float64).reshape(self.nchunk, self.nzone, 2)
+
+    def _map(self, fn, dtype):
+        if fn not in self._maps:
+            fn_ = join(self.sdir, fn)
+            if os.path.getsize(fn_) == 0:
+                self._maps[fn] = zeros(0, dtype)
+            else:
+                self._maps[fn] = memmap(fn_, dtype=dtype, mode='r')
+        return(self._maps[fn])
+
+    @property
+    def names(self):
+        return(list(self.columns))
+
+    def column(self, name):
+        """values of a trial, setting, or summary column
+        args:
+            name - column name
+        returns:
+            v - memory mapped array of numbers, or list of strings"""
+
+        kind, typ, fn = self.columns[name]
+        if kind == 'series':
+            raise(KeyError('%s is a series, use Store.series' % name))
+        if typ == 'str':
+            if fn not in self._maps:
+                raw = self._map(fn + '.str', uint8)
+                off = self._map(fn + '.off', int64)
+                self._maps[fn] = [bytes(raw[off[i]:off[i+1]]).decode() for i in range(self.ntrial)]
+            return(self._maps[fn])
+        return(self._map(fn + '.' + typ, int64 if typ == 'i64' else float64))
+
+    def frame(self, kinds=('setting', 'summary')):
+        """DataFrame of the columns of some kinds, one row for each trial
+        optional args:
+            kinds - kinds of column, from 'setting' and 'summary'
+        returns:
+            df - DataFrame indexed by trial directory"""
+
+        cols = {k: self.column(k) for k,(kind,_,_) in self.columns.items() if kind in kinds}
+        return(pd.DataFrame(cols, index=self.column('trial')))
+
+    def series(self, name, row):
+        """output vector of a trial
+        args:
+            name - name of the vector, like 'evap' for o_evap or 't' for o_t
+            row - row of the trial
+        returns:
+            v - memory mapped slice of the vector"""
+
+        _, _, fn = self.columns[name]
+        return(self._map(fn + '.f64', float64)[self.offsets[row]:self.offsets[row+1]])
+
+    def select(self, **params):
+        """rows of the trials with given values of some columns, skipping
+        the chunks whose ranges don't hold the numeric values
+        args:
+            params - column names and values, like perm0=1e-12
+        returns:
+            rows - array of rows"""
+
+        ok = ones(self.nchunk, dtype=bool)
+        for k,v in params.items():
+            if k in self._zone:
+                z = self.zones[:,self._zone.index(k),:]
+                ok &= (z[:,0] <= v) & (v <= z[:,1])
+        rows = arange(self.ntrial)
+        rows = rows[ok[rows//self.chunk]]
+        for k,v in params.items():
+            col = self.column(k)
+            if isinstance(col, list):
+                rows = array([i for i in rows if col[i] == v], dtype=int)
+            else:
+                rows = rows[col[rows] == v]
+        return(rows)
@@ -0,0 +1,78 @@
+"""
+Checks the delta encoded snaps (the snapdelta setting) against the plain snaps
+of the same trial. Run the trial once with snapdelta = 0 and again with
+snapdelta = 1, with and without deltakey, into separate output directories.
+Every field of every snap should come back bit for bit, both from read_snaps()
+and from the files that decode_snaps.exe writes, which is run on a copy of each
+delta encoded directory.
+usage:
+    python delta_snaps.py <plain output dir> <delta output dir> [<delta output dir> ...]
+"""
+
+import sys
+import subprocess
+import tempfile
+import shutil
+from os import listdir
+from os.path import join, dirname, abspath, isfile
+from numpy import array_equal
+
+sys.path.append(dirname(dirname(__file__)))
+from output_tools.reading import read_snaps
+
+#-------------------------------------------------------------------------------
+# INPUT
+
+assert len(sys.argv) > 2, 'must give a plain output directory and at least one delta encoded one'
+dirplain, dirdeltas = sys.argv[1], sys.argv[2:]
+
+#the decoding tool, built by make in the top directory
+exe = join(dirname(dirname(dirname(abspath(__file__)))), 'bin', 'decode_snaps.exe')
+
+#the fields that can be delta encoded
+fields = ['captherm', 'gradT', 'qT', 'wsat', 'isat', 'T']
+
+#-------------------------------------------------------------------------------
+# FUNCTIONS
+
+def snap_files(tdir, var):
+    """names of a field's snap files in a directory, in order"""
+    fns = [fn for fn in listdir(tdir) if ('_'.join(fn.split('_')[:-1]) == var)]
+    fns = [fn for fn in fns if fn.split('_')[-1].isdigit()]
+    return(sorted(fns, key=lambda fn: int(fn.split('_')[-1])))
+
+#-------------------------------------------------------------------------------
+# MAIN
+
+nbad = 0
+for dirdelta in dirdeltas:
+    print(dirdelta)
+    present = [var for var in fields if snap_files(dirplain, var)]
+    #the snaps should actually be encoded
+    nenc = sum(open(join(dirdelta, fn), 'rb').read(8) == b'BTDELTA1'
+               for var in present for fn in snap_files(dirdelta, var))
+    print('  %d delta encoded files' % nenc)
+    #decoded by the output tools
+    for var in present:
+        a, b = read_snaps(dirplain, var), read_snaps(dirdelta, var)
+        same = (len(a) == len(b)) and all(array_equal(x, y) for x, y in zip(a, b))
+        nbad += not same
+        print('  read_snaps   %-8s %d snaps, %s' % (var, len(b), 'identical' if same else 'DIFFERENT'))
+    #decoded by decode_snaps.exe, on a copy so the directory is left alone
+    tmp = tempfile.mkdtemp()
+    try:
+        dircopy = join(tmp, 'out')
+        shutil.copytree(dirdelta, dircopy)
+        subprocess.check_call([exe, dircopy], stdout=subprocess.DEVNULL)
+        for var in present:
+            fns = snap_files(dirplain, var)
+            same = all(isfile(join(dircopy, fn)) and
+                       open(join(dirplain, fn), 'rb').read() == open(join(dircopy, fn), 'rb').read()
+                       for fn in fns)
+            nbad += not same
+            print('  decode_snaps %-8s %d snaps, %s' % (var, len(fns), 'identical' if same else 'DIFFERENT'))
+    finally:
+        shutil.rmtree(tmp)
+
+print('all snaps identical' if nbad == 0 else '%d fields DIFFERENT' % nbad)
+sys.exit(nbad > 0)
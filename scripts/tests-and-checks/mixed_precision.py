@@ -0,0 +1,43 @@
+"""
+Compares the output of a full precision run with the output of a mixed
+precision run (compiled with prec=-DMIXED_PRECISION) of the same trial. The
+prognostic snaps should be identical, because the diagnostics are always
+computed in double precision, and the diagnostic snaps should differ only by
+their storage rounding.
+usage:
+    python mixed_precision.py <full precision output dir> <mixed precision output dir>
+"""
+
+import sys
+from os.path import join, dirname
+from numpy import *
+
+sys.path.append(dirname(dirname(__file__)))
+from output_tools.reading import read_dtypes, read_tagged
+
+#-------------------------------------------------------------------------------
+# INPUT
+
+assert len(sys.argv) > 2, 'must give full and mixed precision output directories'
+dirfull, dirmix = sys.argv[1], sys.argv[2]
+
+#-------------------------------------------------------------------------------
+# MAIN
+
+#the solver snaps, water table and temperature
+tsnap = fromfile(join(dirfull, 'bous_therm_snap_t'))
+for i in range(len(tsnap)):
+    a = fromfile(join(dirfull, 'bous_therm_snap_%d' % i))
+    b = fromfile(join(dirmix, 'bous_therm_snap_%d' % i))
+    print('snap %d, max abs difference in H and T: %g' % (i, abs(a - b).max()))
+
+#the diagnostics, at whatever precision each run stored them
+dfull, dmix = read_dtypes(dirfull), read_dtypes(dirmix)
+for var in ['captherm', 'gradT', 'qT', 'wsat', 'isat']:
+    for i in range(len(tsnap)):
+        fn = '%s_%d' % (var, i)
+        a = read_tagged(join(dirfull, fn), dfull.get(var, 'float64'))
+        b = read_tagged(join(dirmix, fn), dmix.get(var, 'float64'))
+        err = abs(a - b).max()
+        rel = (abs(a - b)/maximum(abs(a), 1e-300)).max()
+        print('%-8s snap %d, max abs difference %.2e, max rel difference %.2e' % (var, i, err, rel))
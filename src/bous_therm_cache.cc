@@ -0,0 +1,368 @@
+//! \file bous_therm_cache.cc
+
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "bous_therm_io.h"
+#include "bous_therm_cache.h"
+
+//------------------------------------------------------------------------------
+//hashing
+
+ContentHash::ContentHash () {
+    a_ = 0xcbf29ce484222325ULL;
+    b_ = 0x6a09e667f3bcc908ULL;
+    len_ = 0;
+}
+
+void ContentHash::update (const void *p, size_t n) {
+    const unsigned char *c = (const unsigned char*)p;
+    uint64_t a = a_, b = b_;
+    for (size_t i=0; i<n; i++) {
+        //FNV-1a in one lane, a multiply and rotate in the other
+        a = (a ^ c[i])*0x100000001b3ULL;
+        b = (b ^ c[i])*0x9e3779b97f4a7c15ULL;
+        b = (b << 23) | (b >> 41);
+    }
+    a_ = a;
+    b_ = b;
+    len_ += n;
+}
+
+void ContentHash::update (const std::string &s) {
+    uint64_t n = s.length();
+    update(&n, sizeof(n));
+    update(s.data(), s.length());
+}
+
+//final avalanche of a lane, from splitmix64
+static uint64_t mix (uint64_t z) {
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    return(z ^ (z >> 31));
+}
+
+std::string ContentHash::hex () const {
+    char buf[33];
+    snprintf(buf, sizeof(buf), "%016llx%016llx",
+        (unsigned long long)mix(a_ ^ len_),
+        (unsigned long long)mix(b_ + len_*0xff51afd7ed558ccdULL));
+    return(std::string(buf));
+}
+
+std::string hash_file (const std::string &fn) {
+    ContentHash h;
+    FILE *f = fopen(fn.c_str(), "rb");
+    if (f == NULL) {
+        std::cout << "FAILURE: cannot open file " << fn << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::vector<char> buf(1 << 20);
+    size_t n;
+    while ( (n = fread(buf.data(), 1, buf.size(), f)) > 0 ) h.update(buf.data(), n);
+    fclose(f);
+    return(h.hex());
+}
+
+//------------------------------------------------------------------------------
+//files and directories
+
+//whether a path is a regular file or a directory
+static bool is_file (const std::string &path) {
+    struct stat st;
+    return( (stat(path.c_str(), &st) == 0) && S_ISREG(st.st_mode) );
+}
+
+static bool is_dir (const std::string &path) {
+    struct stat st;
+    return( (stat(path.c_str(), &st) == 0) && S_ISDIR(st.st_mode) );
+}
+
+//names in a directory, other than . and ..
+static std::vector<std::string> list_dir (const std::string &dir) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL) return(names);
+    struct dirent *e;
+    while ( (e = readdir(d)) != NULL ) {
+        if ( (strcmp(e->d_name, ".") == 0) || (strcmp(e->d_name, "..") == 0) ) continue;
+        names.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return(names);
+}
+
+std::vector<std::string> list_files (const std::string &dir) {
+    std::vector<std::string> names = list_dir(dir), files;
+    for (unsigned i=0; i<names.size(); i++)
+        if (is_file(dir + "/" + names[i])) files.push_back(names[i]);
+    return(files);
+}
+
+std::vector<std::string> list_dirs (const std::string &dir) {
+    std::vector<std::string> names = list_dir(dir), dirs;
+    for (unsigned i=0; i<names.size(); i++)
+        if (is_dir(dir + "/" + names[i])) dirs.push_back(names[i]);
+    return(dirs);
+}
+
+//copies a file, returning false if it can't
+static bool copy_file (const std::string &src, const std::string &dst) {
+    std::ifstream in(src.c_str(), std::ios::binary);
+    if (!in) return(false);
+    std::ofstream out(dst.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) return(false);
+    out << in.rdbuf();
+    return(bool(out));
+}
+
+//------------------------------------------------------------------------------
+//keys and entries
+
+std::string cache_key (const std::string &settings, const std::string &griddir, const std::string &build) {
+
+    ContentHash h;
+    h.update(std::string("bous_therm result cache 1"));
+    h.update(settings);
+    //every grid file by name and contents
+    std::vector<std::string> files = list_files(griddir);
+    if (files.size() == 0) {
+        std::cout << "FAILURE: no grid files found in " << griddir << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned i=0; i<files.size(); i++) {
+        h.update(files[i]);
+        h.update(hash_file(griddir + "/" + files[i]));
+    }
+    h.update(build);
+
+    return(h.hex());
+}
+
+//reads the lines of a manifest as hashes, sizes, and names
+static bool read_manifest (const std::string &fn, std::vector<std::string> &hashes, std::vector<uint64_t> &sizes, std::vector<std::string> &names) {
+    std::ifstream ifile(fn.c_str());
+    if (!ifile) return(false);
+    std::string line;
+    while (std::getline(ifile, line)) {
+        std::stringstream ls(line);
+        std::string hash, name;
+        uint64_t size;
+        if ( !(ls >> hash >> size) ) continue;
+        //names are the rest of the line
+        std::getline(ls, name);
+        name.erase(0, name.find_first_not_of(' '));
+        hashes.push_back(hash);
+        sizes.push_back(size);
+        names.push_back(name);
+    }
+    return(true);
+}
+
+bool cache_fetch (const std::string &cachedir, const std::string &key, const std::string &dirout, bool link) {
+
+    std::string entry = cachedir + "/" + key;
+    std::vector<std::string> hashes, names;
+    std::vector<uint64_t> sizes;
+    if (!read_manifest(entry + "/manifest.txt", hashes, sizes, names)) return(false);
+    //never serve files that have changed since they were stored
+    std::string msg;
+    if (!cache_verify(cachedir, key, msg)) {
+        printf("WARNING: cache entry %s is damaged (%s) and was removed\n", key.c_str(), msg.c_str());
+        cache_remove(cachedir, key);
+        return(false);
+    }
+
+    for (unsigned i=0; i<names.size(); i++) {
+        std::string src = entry + "/files/" + names[i], dst = dirout + "/" + names[i];
+        //an existing output file is replaced, never written through, so it
+        //can't be a link into the cache that would be overwritten
+        unlink(dst.c_str());
+        if ( link && (::link(src.c_str(), dst.c_str()) == 0) ) continue;
+        if (!copy_file(src, dst)) {
+            std::cout << "FAILURE: cannot copy cached file " << src << " to " << dst << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    //mark the entry as used
+    utime((entry + "/manifest.txt").c_str(), NULL);
+
+    return(true);
+}
+
+long unshare_files (const std::string &dir) {
+    long n = 0;
+    std::vector<std::string> files = list_files(dir);
+    for (unsigned i=0; i<files.size(); i++) {
+        std::string fn = dir + "/" + files[i];
+        struct stat st;
+        if ( (stat(fn.c_str(), &st) != 0) || (st.st_nlink < 2) ) continue;
+        //copy beside it and rename over it, which leaves the other links alone
+        std::stringstream ts;
+        ts << fn << ".tmp." << getpid();
+        if ( !copy_file(fn, ts.str()) || (rename(ts.str().c_str(), fn.c_str()) != 0) ) {
+            std::cout << "FAILURE: cannot replace the linked file " << fn << " with a copy" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        n++;
+    }
+    return(n);
+}
+
+void cache_store (const std::string &cachedir, const std::string &key, const std::string &dirout, time_t since, const std::string &settings, const std::string &griddir, const std::string &build) {
+
+    mkdir(cachedir.c_str(), 0755);
+    std::string entry = cachedir + "/" + key;
+    if (is_dir(entry)) return;
+    //build the entry in a temporary directory
+    std::stringstream ts;
+    ts << entry << ".tmp." << getpid();
+    std::string tmp = ts.str();
+    if ( (mkdir(tmp.c_str(), 0755) != 0) || (mkdir((tmp + "/files").c_str(), 0755) != 0) ) {
+        printf("WARNING: cannot create cache entry %s, results not cached\n", tmp.c_str());
+        return;
+    }
+
+    //copy the output files written by this trial
+    std::vector<std::string> files = list_files(dirout);
+    std::ofstream man((tmp + "/manifest.txt").c_str());
+    uint64_t total = 0;
+    long nfile = 0;
+    for (unsigned i=0; i<files.size(); i++) {
+        std::string src = dirout + "/" + files[i];
+        struct stat st;
+        if ( (stat(src.c_str(), &st) != 0) || (st.st_mtime < since) ) continue;
+        if (!copy_file(src, tmp + "/files/" + files[i])) {
+            printf("WARNING: cannot copy %s into the cache, results not cached\n", src.c_str());
+            man.close();
+            cache_remove(cachedir, tmp.substr(cachedir.length() + 1));
+            return;
+        }
+        man << hash_file(src) << ' ' << uint64_t(st.st_size) << ' ' << files[i] << '\n';
+        total += st.st_size;
+        nfile++;
+    }
+    man.close();
+    //what went into the key
+    std::ofstream(tmp + "/settings.txt") << settings;
+    std::ofstream(tmp + "/info.txt") << "key = " << key << '\n'
+                                     << "grid = " << griddir << '\n'
+                                     << "build = " << build << '\n'
+                                     << "created = " << long(time(NULL)) << '\n';
+
+    //move it into place, unless another trial got there first
+    if (rename(tmp.c_str(), entry.c_str()) != 0) {
+        cache_remove(cachedir, tmp.substr(cachedir.length() + 1));
+        return;
+    }
+    printf("stored %li output files (%.3g MB) in the cache\n", nfile, double(total)/1e6);
+}
+
+//------------------------------------------------------------------------------
+//index
+
+//whether a directory name is a temporary entry
+static bool is_tmp (const std::string &name) {
+    return( name.find(".tmp.") != std::string::npos );
+}
+
+std::vector<CacheEntry> cache_entries (const std::string &cachedir) {
+
+    std::vector<CacheEntry> entries;
+    std::vector<std::string> names = list_dir(cachedir);
+    for (unsigned i=0; i<names.size(); i++) {
+        if (is_tmp(names[i])) continue;
+        std::string entry = cachedir + "/" + names[i];
+        struct stat st;
+        if (stat((entry + "/manifest.txt").c_str(), &st) != 0) continue;
+        CacheEntry e;
+        e.key = names[i];
+        e.used = st.st_mtime;
+        //sizes from the manifest
+        std::vector<std::string> hashes, files;
+        std::vector<uint64_t> sizes;
+        read_manifest(entry + "/manifest.txt", hashes, sizes, files);
+        e.nfile = files.size();
+        e.size = 0;
+        for (unsigned j=0; j<sizes.size(); j++) e.size += sizes[j];
+        //creation time from the info file
+        e.created = e.used;
+        std::ifstream info((entry + "/info.txt").c_str());
+        std::string line, k, v;
+        while (std::getline(info, line)) {
+            if (line.find('=') == std::string::npos) continue;
+            split_string('=', line, k, v);
+            strip_string(k);
+            if (k == "created") e.created = std::atol(v.c_str());
+        }
+        entries.push_back(e);
+    }
+    //least recently used first
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const CacheEntry &a, const CacheEntry &b) { return(a.used < b.used); });
+
+    return(entries);
+}
+
+bool cache_verify (const std::string &cachedir, const std::string &key, std::string &msg) {
+
+    std::string entry = cachedir + "/" + key;
+    std::vector<std::string> hashes, names;
+    std::vector<uint64_t> sizes;
+    if (!read_manifest(entry + "/manifest.txt", hashes, sizes, names)) {
+        msg = "missing manifest";
+        return(false);
+    }
+    for (unsigned i=0; i<names.size(); i++) {
+        std::string fn = entry + "/files/" + names[i];
+        struct stat st;
+        if (stat(fn.c_str(), &st) != 0) {
+            msg = "missing " + names[i];
+            return(false);
+        }
+        if (uint64_t(st.st_size) != sizes[i]) {
+            msg = "wrong size of " + names[i];
+            return(false);
+        }
+        if (hash_file(fn) != hashes[i]) {
+            msg = "wrong hash of " + names[i];
+            return(false);
+        }
+    }
+    msg = "ok";
+    return(true);
+}
+
+long cache_clean (const std::string &cachedir, double age) {
+    long n = 0;
+    time_t now = time(NULL);
+    std::vector<std::string> names = list_dir(cachedir);
+    for (unsigned i=0; i<names.size(); i++) {
+        if (!is_tmp(names[i])) continue;
+        struct stat st;
+        if (stat((cachedir + "/" + names[i]).c_str(), &st) != 0) continue;
+        if (difftime(now, st.st_mtime) < age) continue;
+        cache_remove(cachedir, names[i]);
+        n++;
+    }
+    return(n);
+}
+
+void cache_remove (const std::string &cachedir, const std::string &name) {
+    std::string entry = cachedir + "/" + name;
+    std::vector<std::string> files = list_files(entry + "/files");
+    for (unsigned i=0; i<files.size(); i++) unlink((entry + "/files/" + files[i]).c_str());
+    rmdir((entry + "/files").c_str());
+    files = list_files(entry);
+    for (unsigned i=0; i<files.size(); i++) unlink((entry + "/" + files[i]).c_str());
+    rmdir(entry.c_str());
+}
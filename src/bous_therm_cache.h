@@ -0,0 +1,152 @@
+#ifndef BOUS_THERM_CACHE_H_
+#define BOUS_THERM_CACHE_H_
+
+//! \file bous_therm_cache.h
+
+/*!
+A content addressed cache of model results, so that trials of a parameter sweep that have already been run are copied instead of computed again. Each entry is a directory in the cache directory named after its key, the hash of the canonical settings (see canonical_settings()), the contents of every file in the grid directory, and the build of the model, its git revision and a checksum of the sources and compile flags. An entry holds
+
+    files/        the output files of the trial
+    manifest.txt  one line per output file, "hash size name"
+    settings.txt  the canonical settings
+    info.txt      the grid directory, build, and creation time
+
+Entries are built in a temporary directory and renamed into place, so trials storing the same entry at once don't clash and an entry is only visible when it's complete. The modification time of the manifest is the last time the entry was used. The `result_cache.exe` tool lists, verifies, and evicts entries.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+
+//!streaming 128 bit hash for content addressing, two 64 bit lanes (not cryptographic)
+class ContentHash {
+
+public:
+
+    //!starts an empty hash
+    ContentHash ();
+
+    //!hashes more bytes
+    /*!
+    \param[in] p start of the bytes
+    \param[in] n number of bytes
+    */
+    void update (const void *p, size_t n);
+
+    //!hashes a string, with its length so that consecutive strings can't run together
+    void update (const std::string &s);
+
+    //!32 hexadecimal digits of the hash of everything so far
+    std::string hex () const;
+
+private:
+
+    //!hash lanes
+    uint64_t a_, b_;
+    //!number of bytes hashed
+    uint64_t len_;
+};
+
+//!hash of a file's contents, 32 hexadecimal digits
+/*!
+\param[in] fn path to the file
+*/
+std::string hash_file (const std::string &fn);
+
+//!sorted names of the regular files in a directory, empty if it can't be opened
+/*!
+\param[in] dir path to the directory
+*/
+std::vector<std::string> list_files (const std::string &dir);
+
+//!sorted names of the subdirectories of a directory, empty if it can't be opened
+/*!
+\param[in] dir path to the directory
+*/
+std::vector<std::string> list_dirs (const std::string &dir);
+
+//!computes the cache key of a trial
+/*!
+\param[in] settings canonical settings
+\param[in] griddir path to the grid directory, every regular file in it is hashed
+\param[in] build identifies the build of the model
+*/
+std::string cache_key (const std::string &settings, const std::string &griddir, const std::string &build);
+
+//!copies or links the files of a cache entry into the output directory, if the entry exists
+/*!
+\param[in] cachedir path to the cache directory
+\param[in] key cache key
+\param[in] dirout path to the output directory
+\param[in] link whether to hard link the files instead of copying them, falling back to copying if linking fails
+\return whether the entry was found and passed cache_verify(), a damaged entry is removed
+*/
+bool cache_fetch (const std::string &cachedir, const std::string &key, const std::string &dirout, bool link);
+
+//!replaces the files of a directory that are hard linked elsewhere with copies of their own
+/*!
+Model output is written through fopen(), which truncates a linked file in place, so a trial writing into a directory of linked cache results would change the cache entry as well.
+\param[in] dir path to the directory
+\return number of files replaced
+*/
+long unshare_files (const std::string &dir);
+
+//!stores the output of a trial in the cache
+/*!
+\param[in] cachedir path to the cache directory, created if it doesn't exist
+\param[in] key cache key
+\param[in] dirout path to the output directory
+\param[in] since only output files modified at or after this time are stored, leaving out older files in the output directory
+\param[in] settings canonical settings
+\param[in] griddir path to the grid directory
+\param[in] build identifies the build of the model
+*/
+void cache_store (const std::string &cachedir, const std::string &key, const std::string &dirout, time_t since, const std::string &settings, const std::string &griddir, const std::string &build);
+
+//!summary of a cache entry
+struct CacheEntry {
+    //!key and directory name
+    std::string key;
+    //!number of output files
+    long nfile;
+    //!total size of the output files (bytes)
+    uint64_t size;
+    //!time the entry was stored
+    time_t created;
+    //!time the entry was last stored or fetched
+    time_t used;
+};
+
+//!reads the summaries of all the complete entries in a cache directory, least recently used first
+/*!
+\param[in] cachedir path to the cache directory
+*/
+std::vector<CacheEntry> cache_entries (const std::string &cachedir);
+
+//!checks the files of a cache entry against its manifest
+/*!
+\param[in] cachedir path to the cache directory
+\param[in] key cache key
+\param[out] msg description of the first problem found
+\return whether every file is present with the right size and hash
+*/
+bool cache_verify (const std::string &cachedir, const std::string &key, std::string &msg);
+
+//!deletes temporary entries left behind by trials that stopped while storing
+/*!
+\param[in] cachedir path to the cache directory
+\param[in] age only temporary entries older than this are deleted (s), so entries being stored aren't
+\return number of temporary entries deleted
+*/
+long cache_clean (const std::string &cachedir, double age);
+
+//!deletes a cache entry, or a leftover temporary entry
+/*!
+\param[in] cachedir path to the cache directory
+\param[in] name name of the entry directory
+*/
+void cache_remove (const std::string &cachedir, const std::string &name);
+
+#endif
@@ -0,0 +1,316 @@
+//! \file bous_therm_calibrate.cc
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "bous_therm_calibrate.h"
+
+//!a target value of an output vector at a model time
+struct CalibTarget {
+    //!name of the output vector
+    std::string metric;
+    //!model time (s)
+    double t;
+    //!target value
+    double value;
+};
+
+//splits a comma separated list, ignoring spaces around the items and empty items
+static std::vector<std::string> split_list (const std::string &list) {
+    std::vector<std::string> items;
+    size_t i0 = 0, i1;
+    while (i0 < list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        std::string item = list.substr(i0, i1 - i0);
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        if (item.length() > 0) items.push_back(item);
+        i0 = i1 + 1;
+    }
+    return(items);
+}
+
+//whether a name is an output vector that can be calibrated to
+static bool is_metric (const std::string &metric) {
+    return( (metric == "evap") || (metric == "evapw") || (metric == "maxaqbot") || (metric == "minaqbot") );
+}
+
+//output vector of a model by name
+static const std::vector<double> *metric_vec (BousThermModel *m, const std::string &metric) {
+    if (metric == "evap") return(&m->o_evap);
+    if (metric == "evapw") return(&m->o_evapw);
+    if (metric == "maxaqbot") return(&m->o_maxaqbot);
+    if (metric == "minaqbot") return(&m->o_minaqbot);
+    return(NULL);
+}
+
+//value of an output vector at a time, linear between steps
+static double metric_at (BousThermModel *m, const CalibTarget &c) {
+    const std::vector<double> &t = m->o_t, &v = *metric_vec(m, c.metric);
+    if (c.t <= t.front()) return(v.front());
+    if (c.t >= t.back()) return(v.back());
+    size_t i = std::upper_bound(t.begin(), t.end(), c.t) - t.begin();
+    double w = (c.t - t[i-1])/(t[i] - t[i-1]);
+    return( (1.0 - w)*v[i-1] + w*v[i] );
+}
+
+void calibrate (std::string &griddir, Settings *stg, const char *dirout) {
+
+    //--------------------------------------------------------------------------
+    //parameters and targets
+
+    std::vector<std::string> names = split_list(stg->calib);
+    long np = names.size();
+    std::vector<double> p0(np), sc(np);
+    std::vector<bool> lg(np);
+    for (long q=0; q<np; q++) {
+        double *v = physical_param(*stg, names[q]);
+        if (v == NULL) {
+            std::cout << "FAILURE: no physical parameter named " << names[q] << " to calibrate" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        p0[q] = *v;
+        //positive parameters move by factors, the others by their size
+        lg[q] = (p0[q] > 0.0);
+        sc[q] = (p0[q] != 0.0) ? fabs(p0[q]) : 1.0;
+    }
+    //parameters from the coordinates of the simplex, which are zero at the
+    //settings and change by about one for a doubling
+    auto param = [&] (const std::vector<double> &x, long q) {
+        return( lg[q] ? p0[q]*exp(x[q]) : p0[q] + x[q]*sc[q] );
+    };
+
+    double tint = stg->tend*stg->tunit;
+    std::vector<CalibTarget> targets;
+    std::vector<std::string> items = split_list(stg->calibtarget);
+    for (unsigned i=0; i<items.size(); i++) {
+        size_t ia = items[i].find('@'), ic = items[i].find(':');
+        if ( (ia == std::string::npos) || (ic == std::string::npos) || (ic < ia) ) {
+            std::cout << "FAILURE: calibration targets are written metric@time:value, not " << items[i] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        CalibTarget c;
+        c.metric = items[i].substr(0, ia);
+        c.t = std::atof(items[i].substr(ia + 1, ic - ia - 1).c_str())*stg->tunit;
+        c.value = std::atof(items[i].substr(ic + 1).c_str());
+        if (!is_metric(c.metric)) {
+            std::cout << "FAILURE: unknown calibration metric " << c.metric << ", use evap, evapw, maxaqbot, or minaqbot" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if ( (c.t < 0.0) || (c.t > tint) ) {
+            std::cout << "FAILURE: calibration target " << items[i] << " is outside the trial" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        targets.push_back(c);
+    }
+    if ( (np == 0) || (targets.size() == 0) ) {
+        std::cout << "FAILURE: calibration needs parameters (calib) and targets (calibtarget)" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    //--------------------------------------------------------------------------
+    //models, one for each group of threads
+
+    //enough groups for the four candidates of an iteration or a whole simplex
+    int nthr = omp_get_max_threads();
+    int ngroup = int(std::min(long(nthr), std::max(np + 1, 4L)));
+    int gthr = std::max(1, nthr/ngroup);
+    omp_set_max_active_levels(2);
+
+    std::vector<Settings*> S(ngroup);
+    std::vector<BousThermModel*> M(ngroup);
+    std::vector<double*> U(ngroup);
+    omp_set_num_threads(gthr);
+    for (int g=0; g<ngroup; g++) {
+        S[g] = new Settings(*stg);
+        M[g] = new_model(griddir, S[g], dirout);
+        U[g] = new double[M[g]->get_neq()];
+    }
+    omp_set_num_threads(nthr);
+
+    printf("\ncalibrating %li parameters to %lu targets, %d groups of %d threads evaluate trials\n",
+        np, targets.size(), ngroup, gthr);
+
+    //log of every evaluation
+    std::string fnlog = std::string(dirout) + "/calibration.txt";
+    FILE *flog = fopen(fnlog.c_str(), "w");
+    if (flog == NULL) {
+        std::cout << "FAILURE: cannot open file " << fnlog << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fprintf(flog, "# eval iter");
+    for (long q=0; q<np; q++) fprintf(flog, " %s", names[q].c_str());
+    for (unsigned i=0; i<targets.size(); i++)
+        fprintf(flog, " %s@%g", targets[i].metric.c_str(), targets[i].t/stg->tunit);
+    fprintf(flog, " objective\n");
+
+    //--------------------------------------------------------------------------
+    //evaluation of a batch of points, at once on the groups
+
+    long neval = 0, iter = 0;
+    double tic = omp_get_wtime();
+    auto evaluate = [&] (std::vector< std::vector<double> > &X, std::vector<double> &F) {
+        long n = X.size();
+        std::vector< std::vector<double> > mv(n, std::vector<double>(targets.size()));
+        F.resize(n);
+        #pragma omp parallel for schedule(dynamic) num_threads(ngroup)
+        for (long i=0; i<n; i++) {
+            int g = omp_get_thread_num();
+            for (long q=0; q<np; q++)
+                *physical_param(*S[g], names[q]) = param(X[i], q);
+            M[g]->restart();
+            M[g]->propagate(M[g]->get_sol(), 0.0, tint, stg->nstep, U[g]);
+            //sum of squared relative misfits, infinite if the trial failed
+            double f = 0.0;
+            for (unsigned j=0; j<targets.size(); j++) {
+                mv[i][j] = metric_at(M[g], targets[j]);
+                double d = mv[i][j] - targets[j].value;
+                if (targets[j].value != 0.0) d /= targets[j].value;
+                f += d*d;
+            }
+            F[i] = std::isfinite(f) ? f : INFINITY;
+        }
+        for (long i=0; i<n; i++) {
+            fprintf(flog, "%li %li", neval++, iter);
+            for (long q=0; q<np; q++) fprintf(flog, " %.17g", param(X[i], q));
+            for (unsigned j=0; j<targets.size(); j++) fprintf(flog, " %.17g", mv[i][j]);
+            fprintf(flog, " %.17g\n", F[i]);
+        }
+        fflush(flog);
+    };
+
+    //--------------------------------------------------------------------------
+    //Nelder-Mead
+
+    //initial simplex around the settings
+    std::vector< std::vector<double> > X(np+1, std::vector<double>(np));
+    std::vector<double> F;
+    for (long i=0; i<=np; i++) {
+        for (long q=0; q<np; q++) X[i][q] = 0.0;
+        if (i > 0) {
+            long q = i - 1;
+            X[i][q] = lg[q] ? log(1.0 + stg->calibstep) : stg->calibstep;
+        }
+    }
+    evaluate(X, F);
+
+    std::vector<double> xc(np);
+    std::vector< std::vector<double> > C(4, std::vector<double>(np));
+    bool conv = false;
+    for (iter=1; iter<=stg->calibiter; iter++) {
+        //order the vertices from best to worst
+        std::vector<long> idx(np+1);
+        for (long i=0; i<=np; i++) idx[i] = i;
+        std::stable_sort(idx.begin(), idx.end(), [&](long a, long b) { return(F[a] < F[b]); });
+        std::vector< std::vector<double> > Xs(np+1);
+        std::vector<double> Fs(np+1);
+        for (long i=0; i<=np; i++) {
+            Xs[i] = X[idx[i]];
+            Fs[i] = F[idx[i]];
+        }
+        X = Xs;
+        F = Fs;
+        //stop when the simplex has collapsed onto the best vertex
+        double size = 0.0;
+        for (long i=1; i<=np; i++)
+            for (long q=0; q<np; q++)
+                size = std::max(size, fabs(X[i][q] - X[0][q]));
+        if (size < stg->calibtol) {
+            conv = true;
+            break;
+        }
+
+        //reflection, expansion, outside and inside contraction through the
+        //centroid of all but the worst vertex
+        for (long q=0; q<np; q++) {
+            xc[q] = 0.0;
+            for (long i=0; i<np; i++) xc[q] += X[i][q]/double(np);
+            double d = xc[q] - X[np][q];
+            C[0][q] = xc[q] + d;
+            C[1][q] = xc[q] + 2.0*d;
+            C[2][q] = xc[q] + 0.5*d;
+            C[3][q] = xc[q] - 0.5*d;
+        }
+        //with a group for each, every candidate is evaluated at once,
+        //otherwise the reflection first and the others only when needed
+        std::vector<double> FC(4, NAN);
+        if (ngroup >= 4) evaluate(C, FC);
+        auto cand = [&] (long i) {
+            if (std::isnan(FC[i])) {
+                std::vector< std::vector<double> > Ci(1, C[i]);
+                std::vector<double> Fi;
+                evaluate(Ci, Fi);
+                FC[i] = Fi[0];
+            }
+            return(FC[i]);
+        };
+
+        //the usual rules
+        const char *move;
+        long pick = -1;
+        double fr = cand(0);
+        if (fr < F[0]) {
+            pick = (cand(1) < fr) ? 1 : 0;
+            move = (pick == 1) ? "expansion" : "reflection";
+        } else if (fr < F[np-1]) {
+            pick = 0;
+            move = "reflection";
+        } else if (fr < F[np]) {
+            if (cand(2) <= fr) pick = 2;
+            move = "outside contraction";
+        } else {
+            if (cand(3) < F[np]) pick = 3;
+            move = "inside contraction";
+        }
+        if (pick >= 0) {
+            X[np] = C[pick];
+            F[np] = FC[pick];
+        } else {
+            //shrink toward the best vertex
+            move = "shrink";
+            std::vector< std::vector<double> > Xk(X.begin() + 1, X.end());
+            std::vector<double> Fk;
+            for (long i=0; i<np; i++)
+                for (long q=0; q<np; q++)
+                    Xk[i][q] = X[0][q] + 0.5*(Xk[i][q] - X[0][q]);
+            evaluate(Xk, Fk);
+            for (long i=0; i<np; i++) {
+                X[i+1] = Xk[i];
+                F[i+1] = Fk[i];
+            }
+        }
+        printf("  iteration %3li: best objective %.4e, simplex size %.2e, %s\n", iter, std::min(F[0], F[np]), size, move);
+    }
+    //the last iteration only checked for convergence
+    if (conv || (iter > stg->calibiter)) iter--;
+    fclose(flog);
+
+    //--------------------------------------------------------------------------
+    //best point
+
+    long ib = std::min_element(F.begin(), F.end()) - F.begin();
+    printf("calibration %s after %li iterations and %li trials, %g sec\n",
+        conv ? "converged" : "stopped", iter, neval, omp_get_wtime() - tic);
+    printf("best objective %.6e with\n", F[ib]);
+    std::string fnbest = std::string(dirout) + "/calib_best.txt";
+    FILE *fbest = fopen(fnbest.c_str(), "w");
+    for (long q=0; q<np; q++) {
+        double v = param(X[ib], q);
+        printf("  %s = %.10g\n", names[q].c_str(), v);
+        if (fbest != NULL) fprintf(fbest, "%s = %.17g\n", names[q].c_str(), v);
+        *physical_param(*stg, names[q]) = v;
+    }
+    if (fbest != NULL) fclose(fbest);
+    std::cout << std::endl;
+
+    //--------------------------------------------------------------------------
+    //clean up
+
+    for (int g=0; g<ngroup; g++) {
+        delete M[g];
+        delete S[g];
+        delete [] U[g];
+    }
+}
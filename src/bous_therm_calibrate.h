@@ -0,0 +1,29 @@
+#ifndef BOUS_THERM_CALIBRATE_H_
+#define BOUS_THERM_CALIBRATE_H_
+
+//! \file bous_therm_calibrate.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "omp.h"
+
+#include "bous_therm_settings.h"
+#include "bous_therm_model.h"
+
+//!fits physical parameters to target values of the output vectors with the Nelder-Mead method
+/*!
+The parameters named in `calib` are varied, starting from their values in the settings, to minimize the sum of squared relative misfits to the targets in `calibtarget`. Each target is written `metric@time:value`, where the metric is one of the output vectors evap, evapw, maxaqbot, or minaqbot, the time is in tunit, and the model value is interpolated linearly between steps. A misfit is relative to the target value, or absolute if the target is zero. Positive parameters are varied in their logarithms, so a permeability moves by factors, and others directly. The initial simplex changes each parameter in turn by `calibstep`, relatively.
+
+Every evaluation integrates the whole trial in fixed steps, in process. There's a model for each group of threads, built once, and each evaluation restarts one with BousThermModel::restart(), so the grid is read and the buffers are allocated only once. The points of the initial simplex and of a shrink are evaluated at once on the groups. With at least four groups, so are the reflection, expansion, and both contractions of every iteration, and the usual Nelder-Mead rules then pick among the candidates, so an iteration costs about one trial of wall time. With fewer groups the reflection is evaluated first and the other candidates only when the rules need them. Iterations stop when every vertex is within `calibtol` of the best, relatively, or after `calibiter` iterations.
+
+Every evaluation is logged to `calibration.txt` in the output directory, with its parameters, the metric at each target, and the objective. The best parameters are written to `calib_best.txt` as settings lines, and copied into the settings, so the trial that follows runs with them.
+\param[in] griddir path to the grid directory
+\param[in,out] stg settings, the calibrated parameters are set to the best values found
+\param[in] dirout path to the output directory
+*/
+void calibrate (std::string &griddir, Settings *stg, const char *dirout);
+
+#endif
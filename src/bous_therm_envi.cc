@@ -0,0 +1,277 @@
+//! \file bous_therm_envi.cc
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <map>
+
+#include "bous_therm_envi.h"
+
+//------------------------------------------------------------------------------
+//header parsing
+
+//reads the key = value pairs of an ENVI header, where values in braces may
+//span several lines
+static std::map<std::string,std::string> read_envi_header (const std::string &fn) {
+
+    check_file_read(fn.c_str());
+    std::ifstream ifile(fn.c_str());
+    std::stringstream ss;
+    ss << ifile.rdbuf();
+    std::string txt = ss.str();
+
+    std::map<std::string,std::string> h;
+    size_t i = 0;
+    while (i < txt.length()) {
+        //next line with an equal sign
+        size_t eol = txt.find('\n', i);
+        if (eol == std::string::npos) eol = txt.length();
+        size_t eq = txt.find('=', i);
+        if ( (eq == std::string::npos) || (eq > eol) ) {
+            i = eol + 1;
+            continue;
+        }
+        std::string key = txt.substr(i, eq - i), val;
+        strip_string(key);
+        //a braced value runs to the closing brace, otherwise to the end of the line
+        size_t v0 = txt.find_first_not_of(" \t", eq + 1);
+        if ( (v0 != std::string::npos) && (txt[v0] == '{') ) {
+            size_t v1 = txt.find('}', v0);
+            if (v1 == std::string::npos) v1 = txt.length();
+            val = txt.substr(v0 + 1, v1 - v0 - 1);
+            eol = txt.find('\n', v1);
+            if (eol == std::string::npos) eol = txt.length();
+        } else {
+            val = txt.substr(eq + 1, eol - eq - 1);
+        }
+        strip_string(val);
+        h[key] = val;
+        i = eol + 1;
+    }
+
+    return(h);
+}
+
+//gets a required header value
+static std::string envi_value (std::map<std::string,std::string> &h, const char *key, const std::string &fn) {
+    if (h.find(key) == h.end()) {
+        std::cout << "FAILURE: ENVI header " << fn << " is missing \"" << key << "\"" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return(h[key]);
+}
+
+//------------------------------------------------------------------------------
+//raster
+
+EnviRaster::EnviRaster (const std::string &fn) {
+
+    //header and data file names
+    std::string base = fn, fnhdr, fnimg;
+    size_t dot = fn.find_last_of('.');
+    if ( (dot != std::string::npos) && (fn.find('/', dot) == std::string::npos) )
+        base = fn.substr(0, dot);
+    fnhdr = base + ".hdr";
+    fnimg = base + ".img";
+    {
+        FILE *f = fopen(fnimg.c_str(), "rb");
+        if (f == NULL) fnimg = base;
+        else fclose(f);
+    }
+
+    //parse the header
+    std::map<std::string,std::string> h = read_envi_header(fnhdr);
+    ncol = std::atol(envi_value(h, "samples", fnhdr).c_str());
+    nrow = std::atol(envi_value(h, "lines", fnhdr).c_str());
+    dtype = std::atoi(envi_value(h, "data type", fnhdr).c_str());
+    long nband = h.count("bands") ? std::atol(h["bands"].c_str()) : 1;
+    long offset = h.count("header offset") ? std::atol(h["header offset"].c_str()) : 0;
+    int order = h.count("byte order") ? std::atoi(h["byte order"].c_str()) : 0;
+    if ( (nband > 1) && h.count("interleave") && (h["interleave"] != "bsq") ) {
+        std::cout << "FAILURE: only band sequential (bsq) ENVI rasters can be read with several bands" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    switch (dtype) {
+        case 1: nbyte_ = 1; break;  //uint8
+        case 2: nbyte_ = 2; break;  //int16
+        case 3: nbyte_ = 4; break;  //int32
+        case 4: nbyte_ = 4; break;  //float32
+        case 5: nbyte_ = 8; break;  //float64
+        case 12: nbyte_ = 2; break; //uint16
+        default:
+            std::cout << "FAILURE: unsupported ENVI data type " << dtype << std::endl;
+            exit(EXIT_FAILURE);
+    }
+    //byte order 0 is little endian, compared with this machine
+    uint16_t one = 1;
+    bool little = ( *((unsigned char*)&one) == 1 );
+    swap_ = ( (order == 0) != little );
+
+    //map info is {projection, ref pixel x, ref pixel y, easting, northing, dx, dy, ...}
+    std::vector<std::string> mi;
+    {
+        std::stringstream ms(envi_value(h, "map info", fnhdr));
+        std::string item;
+        while (std::getline(ms, item, ',')) {
+            strip_string(item);
+            mi.push_back(item);
+        }
+    }
+    if (mi.size() < 7) {
+        std::cout << "FAILURE: incomplete map info in " << fnhdr << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    projection = mi[0];
+    refj_ = std::atof(mi[1].c_str());
+    refi_ = std::atof(mi[2].c_str());
+    easting = std::atof(mi[3].c_str()) - (refj_ - 1.0)*std::atof(mi[5].c_str());
+    northing = std::atof(mi[4].c_str()) + (refi_ - 1.0)*std::atof(mi[6].c_str());
+    dx = std::atof(mi[5].c_str());
+    dy = std::atof(mi[6].c_str());
+
+    //radius of the sphere, the number after the name in SPHEROID["name",radius,...]
+    radius = NAN;
+    if (h.count("coordinate system string")) {
+        std::string cs = h["coordinate system string"];
+        size_t k = cs.find("SPHEROID[");
+        if (k != std::string::npos) {
+            k = cs.find(',', k);
+            if (k != std::string::npos) radius = std::atof(cs.c_str() + k + 1);
+        }
+    }
+
+    //map the data file
+    int fd = open(fnimg.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "FAILURE: cannot open ENVI data file " << fnimg << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    mapsize_ = st.st_size;
+    if ( size_t(offset) + size_t(ncol)*size_t(nrow)*nbyte_ > mapsize_ ) {
+        std::cout << "FAILURE: ENVI data file " << fnimg << " is smaller than its header says" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    map_ = mmap(NULL, mapsize_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+        std::cout << "FAILURE: cannot map ENVI data file " << fnimg << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    data_ = (const unsigned char*)map_ + offset;
+}
+
+EnviRaster::~EnviRaster () {
+    munmap(map_, mapsize_);
+}
+
+double EnviRaster::pixel (long i, long j) const {
+
+    //copy the bytes of the pixel, reversed if necessary
+    unsigned char b[8];
+    const unsigned char *p = data_ + (size_t(i)*size_t(ncol) + size_t(j))*nbyte_;
+    for (int k=0; k<nbyte_; k++) b[k] = swap_ ? p[nbyte_-1-k] : p[k];
+    //convert to double
+    switch (dtype) {
+        case 1: return( double(b[0]) );
+        case 2: { int16_t v; memcpy(&v, b, 2); return(v); }
+        case 3: { int32_t v; memcpy(&v, b, 4); return(v); }
+        case 4: { float v; memcpy(&v, b, 4); return(v); }
+        case 5: { double v; memcpy(&v, b, 8); return(v); }
+        default: { uint16_t v; memcpy(&v, b, 2); return(v); }
+    }
+}
+
+double EnviRaster::sample (double e, double n) const {
+
+    //continuous pixel coordinates, with pixel centers at whole numbers
+    double u = (e - easting)/dx - 0.5;
+    double v = (northing - n)/dy - 0.5;
+    //clamp to the pixel centers on the edges
+    u = std::min(std::max(u, 0.0), double(ncol - 1));
+    v = std::min(std::max(v, 0.0), double(nrow - 1));
+    //surrounding pixels and weights
+    long j = std::min(long(u), ncol - 2 > 0 ? ncol - 2 : 0);
+    long i = std::min(long(v), nrow - 2 > 0 ? nrow - 2 : 0);
+    double fu = u - j, fv = v - i;
+    long j1 = std::min(j + 1, ncol - 1), i1 = std::min(i + 1, nrow - 1);
+    return( (1 - fv)*((1 - fu)*pixel(i, j) + fu*pixel(i, j1))
+               + fv*((1 - fu)*pixel(i1, j) + fu*pixel(i1, j1)) );
+}
+
+void EnviRaster::straight_transect (double e0, double n0, double e1, double n1, long npts, std::vector<double> &s, std::vector<double> &z) const {
+
+    s.resize(npts);
+    z.resize(npts);
+    double L = sqrt((e1 - e0)*(e1 - e0) + (n1 - n0)*(n1 - n0));
+    for (long k=0; k<npts; k++) {
+        double f = double(k)/double(npts - 1);
+        s[k] = f*L;
+        z[k] = sample(e0 + f*(e1 - e0), n0 + f*(n1 - n0));
+    }
+}
+
+void EnviRaster::great_circle_transect (double e0, double n0, double e1, double n1, long npts, std::vector<double> &s, std::vector<double> &z) const {
+
+    if ( (projection != "Equirectangular") || std::isnan(radius) ) {
+        std::cout << "FAILURE: great circle transects need an Equirectangular raster with a spheroid radius" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    //longitude relative to the central meridian and latitude of the ends,
+    //as unit vectors
+    double a[3], b[3];
+    double lon = e0/radius, lat = n0/radius;
+    a[0] = cos(lat)*cos(lon); a[1] = cos(lat)*sin(lon); a[2] = sin(lat);
+    lon = e1/radius; lat = n1/radius;
+    b[0] = cos(lat)*cos(lon); b[1] = cos(lat)*sin(lon); b[2] = sin(lat);
+    //angle between the ends
+    double c[3] = {a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0]};
+    double w = atan2(sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]), a[0]*b[0] + a[1]*b[1] + a[2]*b[2]);
+
+    s.resize(npts);
+    z.resize(npts);
+    for (long k=0; k<npts; k++) {
+        double f = double(k)/double(npts - 1);
+        //spherical linear interpolation between the ends
+        double p[3];
+        if (w > 0.0) {
+            double ca = sin((1 - f)*w)/sin(w), cb = sin(f*w)/sin(w);
+            for (int d=0; d<3; d++) p[d] = ca*a[d] + cb*b[d];
+        } else {
+            for (int d=0; d<3; d++) p[d] = a[d];
+        }
+        //back to map coordinates
+        lat = asin(std::min(std::max(p[2], -1.0), 1.0));
+        lon = atan2(p[1], p[0]);
+        s[k] = f*w*radius;
+        z[k] = sample(lon*radius, lat*radius);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<Transect> read_transects (const std::string &fn) {
+
+    check_file_read(fn.c_str());
+    std::ifstream ifile(fn.c_str());
+    std::vector<Transect> tr;
+    std::string line;
+    while (std::getline(ifile, line)) {
+        strip_string(line);
+        if ( (line.length() == 0) || (line[0] == '#') ) continue;
+        std::stringstream ls(line);
+        Transect t;
+        if ( !(ls >> t.name >> t.e0 >> t.n0 >> t.e1 >> t.n1) ) {
+            std::cout << "FAILURE: bad transect line in " << fn << ": " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        tr.push_back(t);
+    }
+
+    return(tr);
+}
@@ -0,0 +1,115 @@
+#ifndef BOUS_THERM_ENVI_H_
+#define BOUS_THERM_ENVI_H_
+
+//! \file bous_therm_envi.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include "bous_therm_io.h"
+
+//!read-only, memory mapped ENVI raster of topography
+/*!
+The header (`.hdr`) is parsed for the size, data type, byte order, header offset, map info, and the planetary radius in the coordinate system string. The data file (`.img`, or the header path without its extension) is memory mapped, so opening a raster of any size is immediate and only the pages touched by sampling are read from disk. Only the first band is used and the interleave must be band sequential if there are several bands. Map coordinates are easting and northing in meters, as in the `map info` line, and elevations are sampled bilinearly between pixel centers, clamping to the raster edges.
+*/
+class EnviRaster {
+
+public:
+
+    //!opens a raster
+    /*!
+    \param[in] fn path to the header or data file
+    */
+    EnviRaster (const std::string &fn);
+    //!unmaps the data
+    ~EnviRaster ();
+
+    //!number of columns (samples)
+    long ncol;
+    //!number of rows (lines)
+    long nrow;
+    //!ENVI data type code
+    int dtype;
+    //!easting of the upper left corner of the upper left pixel (m)
+    double easting;
+    //!northing of the upper left corner of the upper left pixel (m)
+    double northing;
+    //!pixel width (m)
+    double dx;
+    //!pixel height (m)
+    double dy;
+    //!planetary radius from the coordinate system string (m), or NAN if not found
+    double radius;
+    //!projection name from the map info
+    std::string projection;
+
+    //!value of a single pixel
+    /*!
+    \param[in] i row
+    \param[in] j column
+    */
+    double pixel (long i, long j) const;
+
+    //!bilinearly interpolated elevation at a map coordinate
+    /*!
+    \param[in] e easting (m)
+    \param[in] n northing (m)
+    */
+    double sample (double e, double n) const;
+
+    //!samples a straight line in map coordinates
+    /*!
+    \param[in] e0 easting of the first point (m)
+    \param[in] n0 northing of the first point (m)
+    \param[in] e1 easting of the last point (m)
+    \param[in] n1 northing of the last point (m)
+    \param[in] npts number of evenly spaced samples, including the ends
+    \param[out] s distance of each sample from the first point (m)
+    \param[out] z elevation of each sample
+    */
+    void straight_transect (double e0, double n0, double e1, double n1, long npts, std::vector<double> &s, std::vector<double> &z) const;
+
+    //!samples a great circle between two map coordinates
+    /*!
+    Only for equirectangular (equidistant cylindrical) rasters on a sphere, with the standard parallel at the equator. Points are evenly spaced in arc length along the great circle and distances are arc lengths on the sphere. The arguments are the same as straight_transect().
+    */
+    void great_circle_transect (double e0, double n0, double e1, double n1, long npts, std::vector<double> &s, std::vector<double> &z) const;
+
+private:
+
+    //!start of the mapped data file
+    void *map_;
+    //!size of the mapping in bytes
+    size_t mapsize_;
+    //!start of the first band's pixels
+    const unsigned char *data_;
+    //!bytes per pixel
+    int nbyte_;
+    //!whether the data's byte order differs from the machine's
+    bool swap_;
+    //!1-based pixel coordinates of the map info reference point
+    double refi_, refj_;
+};
+
+//------------------------------------------------------------------------------
+
+//!a transect to cut out of a raster for a grid
+struct Transect {
+    //!name, used as the grid directory name in batches
+    std::string name;
+    //!easting and northing of the first point (m)
+    double e0, n0;
+    //!easting and northing of the last point (m)
+    double e1, n1;
+};
+
+//!reads a file of transects, one per line as "name e0 n0 e1 n1", ignoring blank lines and lines starting with #
+/*!
+\param[in] fn path to the file
+*/
+std::vector<Transect> read_transects (const std::string &fn);
+
+#endif
@@ -37,19 +37,52 @@ BousThermGrid::BousThermGrid (const std::string &griddir_) {
     //cell widths
     delx = alloc_read_double(griddir, "delx", delx, Nx);
 
-    //topography
-    ztope = alloc_read_double(griddir, "ztope", ztope, Nx+1);
-    ztopc = alloc_read_double(griddir, "ztopc", ztopc, Nx);
-    htope = new double[Nx+1];
-    double ztopemin = min(ztope, Nx+1);
-    for (long j=0; j<Nx+1; j++)
-        htope[j] = ztope[j] - ztopemin;
+    // --- Y ---
+    if ( file_exists(griddir, "Ny.txt") ) {
+        //number of rows in a map-view domain
+        Ny = read_one_long(griddir, "Ny.txt");
+        //row edge coordinates
+        ye = alloc_read_double(griddir, "ye", ye, Ny+1);
+        //row center coordinates
+        yc = alloc_read_double(griddir, "yc", yc, Ny);
+        //row widths
+        dely = alloc_read_double(griddir, "dely", dely, Ny);
+    } else {
+        //a transect is a single row of unit width
+        Ny = 1;
+        ye = new double[2];
+        ye[0] = 0.0;
+        ye[1] = 1.0;
+        yc = new double[1];
+        yc[0] = 0.5;
+        dely = new double[1];
+        dely[0] = 1.0;
+    }
+
+    //total numbers of columns and cells
+    Ncol = Ny*(Nx+1);
+    Ncell = Ny*Nx;
+
+    //topography, stored row by row
+    ztope = alloc_read_double(griddir, "ztope", ztope, Ncol);
+    ztopc = alloc_read_double(griddir, "ztopc", ztopc, Ncell);
+    htope = new double[Ncol];
+    double ztopemin = min(ztope, Ncol);
+    for (long k=0; k<Ncol; k++)
+        htope[k] = ztope[k] - ztopemin;
+
+    //a single tile until the model decides how to split the domain
+    Ntile = 0;
+    tiles = NULL;
+    make_tiles(Nx+1, Ny);
 
     //-----------------------------------------------------------
 
     std::cout << "grid loaded" << std::endl;
     printf("  z domain is [%g,%g] with %li nodes\n", 0.0, zdepth, Nz);
     printf("  x domain is [%g,%g] with %li cells\n", xa, xb, Nx);
+    if (Ny > 1)
+        printf("  y domain is [%g,%g] with %li rows\n", ye[0], ye[Ny], Ny);
 }
 
 BousThermGrid::~BousThermGrid () {
@@ -66,4 +99,37 @@ BousThermGrid::~BousThermGrid () {
     frei(ztope);
     frei(ztopc);
     frei(htope);
+    //free the y coordinates
+    frei(ye);
+    frei(yc);
+    frei(dely);
+    //free the tiles
+    frei(tiles);
+}
+
+void BousThermGrid::make_tiles (long tnx, long tny) {
+
+    //keep the tile dimensions inside the domain
+    if (tnx < 1) tnx = 1;
+    if (tnx > Nx+1) tnx = Nx+1;
+    if (tny < 1) tny = 1;
+    if (tny > Ny) tny = Ny;
+
+    //number of tiles in each direction
+    long ntx = (Nx + 1 + tnx - 1)/tnx;
+    long nty = (Ny + tny - 1)/tny;
+
+    //replace any existing tiles
+    frei(tiles);
+    Ntile = ntx*nty;
+    tiles = new Tile[Ntile];
+    for (long a=0; a<nty; a++) {
+        for (long b=0; b<ntx; b++) {
+            Tile *t = tiles + a*ntx + b;
+            t->r0 = a*tny;
+            t->r1 = std::min((a + 1)*tny, Ny);
+            t->j0 = b*tnx;
+            t->j1 = std::min((b + 1)*tnx, Nx + 1);
+        }
+    }
 }
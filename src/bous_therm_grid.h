@@ -6,13 +6,31 @@
 #include <iostream>
 #include <cstdio>
 #include <string>
+#include <algorithm>
 
 #include "bous_therm_io.h"
 #include "bous_therm_util.h"
 
+//!rectangular block of thermal columns, the unit of work shared between threads
+/*!
+A tile covers rows `r0` through `r1-1` and horizontal cell edges `j0` through `j1-1`. The hydraulic cells owned by a tile are the cells whose left edge is in the tile.
+*/
+struct Tile {
+    //!first row in the tile
+    long r0;
+    //!one past the last row in the tile
+    long r1;
+    //!first horizontal edge (thermal column) in the tile
+    long j0;
+    //!one past the last horizontal edge in the tile
+    long j1;
+};
+
 //!Base class storing grid information
 /*!
-The BousThermGrid class is the base class of the model which contains grid spacing coordinates. It has no functionality and is just a container for grid variables.
+The BousThermGrid class is the base class of the model which contains grid spacing coordinates. It is mostly a container for grid variables, plus the decomposition of the map-view domain into tiles.
+
+A transect is a single row of cells (Ny = 1). A map-view domain is a tensor product of the x grid and a y grid with Ny rows, where each row is laid out exactly like a transect: Nx hydraulic cells with thermal columns on the Nx+1 cell edges. Rows are stacked in y and coupled by groundwater flow across the y faces between them. All two-dimensional arrays are stored row by row, so element `j` of row `r` has index `r*(Nx+1) + j` for edge arrays and `r*Nx + j` for cell arrays.
 */
 class BousThermGrid {
 
@@ -20,7 +38,7 @@ public:
 
     //!constructs
     /*!
-    The constructor looks for files written by the `generate_grid.py` script. If any of them aren't found, an error is thrown.
+    The constructor looks for files written by the `generate_grid.py` script. If any of them aren't found, an error is thrown. If the file `Ny.txt` is present, the grid is a map-view domain and the files `ye`, `yc`, and `dely` are also read. In that case the topography files `ztope` and `ztopc` contain Ny rows. Without `Ny.txt`, the grid is a transect of unit width.
     \param[in] griddir path to directory containing grid files
     */
     BousThermGrid (const std::string &griddir);
@@ -66,6 +84,37 @@ public:
     //!topographic height above lowest point at cell edges
     double *htope;
 
+    // --- Y ---
+    //!number of rows in the map-view domain (1 for a transect)
+    long Ny;
+    //!row edge coordinates
+    double *ye;
+    //!row center coordinates
+    double *yc;
+    //!row widths (1 for a transect, so that fluxes are per unit width)
+    double *dely;
+
+    // --- totals ---
+    //!total number of thermal columns, Ny*(Nx+1)
+    long Ncol;
+    //!total number of hydraulic cells, Ny*Nx
+    long Ncell;
+
+    //--------------------------------------------------------------------------
+    //DOMAIN DECOMPOSITION
+
+    //!number of tiles
+    long Ntile;
+    //!tiles covering the domain, ordered row by row
+    Tile *tiles;
+
+    //!splits the domain into tiles
+    /*!
+    \param[in] tnx number of horizontal edges (thermal columns) per tile
+    \param[in] tny number of rows per tile
+    */
+    void make_tiles (long tnx, long tny);
+
 };
 
 #endif
@@ -0,0 +1,452 @@
+//! \file bous_therm_gridgen.cc
+
+#include <sys/stat.h>
+
+#include "bous_therm_gridgen.h"
+
+//------------------------------------------------------------------------------
+//settings
+
+GridSettings parse_grid_settings ( std::vector< std::vector< std::string > > sv ) {
+
+    GridSettings s;
+    const char *set, *val;
+
+    //defaults are the inputs of generate_grid.py
+    s.Nx0    = 100;
+    s.xa     = -2e6;
+    s.xb     = 5e5;
+    s.G0     = 12*1e-4;
+    s.G1     = 12*2e-3;
+    s.G2     = 12*1e2;
+    s.smooth = true;
+    s.zdepth = 2e3;
+    s.delz0  = 0.3;
+    s.fdelz  = 1.01;
+    s.fnxtopo = "";
+    s.fnztopo = "";
+    s.fnenvi  = "";
+    s.te0     = 0.0;
+    s.tn0     = 0.0;
+    s.te1     = 0.0;
+    s.tn1     = 0.0;
+    s.tnpts   = 1000;
+    s.tpath   = "straight";
+    s.ts0     = 0.0;
+    s.fntransects = "";
+    s.Ny      = 0;
+    s.ya      = 0.0;
+    s.yb      = 0.0;
+    s.yslope  = 0.0;
+
+    for (int i=0; i < int(sv.size()); i++) {
+
+        //get the setting and value pair
+        set = sv[i][0].c_str();
+        val = sv[i][1].c_str();
+
+        //get the setting
+
+        if      ( cmp(set, "Nx0") )     s.Nx0     = to_long(val);
+        else if ( cmp(set, "xa") )      s.xa      = std::atof(val);
+        else if ( cmp(set, "xb") )      s.xb      = std::atof(val);
+        else if ( cmp(set, "G0") )      s.G0      = std::atof(val);
+        else if ( cmp(set, "G1") )      s.G1      = std::atof(val);
+        else if ( cmp(set, "G2") )      s.G2      = std::atof(val);
+        else if ( cmp(set, "smooth") )  s.smooth  = std::atoi(val);
+
+        else if ( cmp(set, "zdepth") )  s.zdepth  = std::atof(val);
+        else if ( cmp(set, "delz0") )   s.delz0   = std::atof(val);
+        else if ( cmp(set, "fdelz") )   s.fdelz   = std::atof(val);
+
+        else if ( cmp(set, "fnxtopo") ) s.fnxtopo = val;
+        else if ( cmp(set, "fnztopo") ) s.fnztopo = val;
+
+        else if ( cmp(set, "fnenvi") )  s.fnenvi  = val;
+        else if ( cmp(set, "te0") )     s.te0     = std::atof(val);
+        else if ( cmp(set, "tn0") )     s.tn0     = std::atof(val);
+        else if ( cmp(set, "te1") )     s.te1     = std::atof(val);
+        else if ( cmp(set, "tn1") )     s.tn1     = std::atof(val);
+        else if ( cmp(set, "tnpts") )   s.tnpts   = to_long(val);
+        else if ( cmp(set, "tpath") )   s.tpath   = val;
+        else if ( cmp(set, "ts0") )     s.ts0     = std::atof(val);
+        else if ( cmp(set, "fntransects") ) s.fntransects = val;
+
+        else if ( cmp(set, "Ny") )      s.Ny      = to_long(val);
+        else if ( cmp(set, "ya") )      s.ya      = std::atof(val);
+        else if ( cmp(set, "yb") )      s.yb      = std::atof(val);
+        else if ( cmp(set, "yslope") )  s.yslope  = std::atof(val);
+
+        else {
+            std::cout << "FAILURE: unknown setting in grid settings file: " << set << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ( (s.tpath != "straight") && (s.tpath != "greatcircle") ) {
+        std::cout << "FAILURE: tpath must be \"straight\" or \"greatcircle\", not \"" << s.tpath << "\"" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (s.tnpts < 2) {
+        std::cout << "FAILURE: tnpts must be at least 2" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if ( (s.Ny < 0) || ( (s.Ny > 0) && (s.yb <= s.ya) ) ) {
+        std::cout << "FAILURE: a map-view grid needs Ny > 0 rows and yb > ya" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return(s);
+}
+
+//------------------------------------------------------------------------------
+//topography
+
+TopoProfile::TopoProfile () {
+    px.push_back(0.0);
+    px.push_back(1.0);
+    pz.push_back(0.0);
+    pz.push_back(0.0);
+}
+
+TopoProfile::TopoProfile (const std::vector<double> &x, const std::vector<double> &z) {
+
+    if ( (x.size() != z.size()) || (x.size() < 2) ) {
+        std::cout << "FAILURE: a topography profile needs at least two points and the same number of coordinates and elevations" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    //sort the points by horizontal coordinate
+    std::vector<long> idx(x.size());
+    for (unsigned long i=0; i<x.size(); i++) idx[i] = i;
+    std::sort(idx.begin(), idx.end(), [&x](long a, long b) { return(x[a] < x[b]); });
+    for (unsigned long i=0; i<x.size(); i++) {
+        px.push_back(x[idx[i]]);
+        pz.push_back(z[idx[i]]);
+    }
+}
+
+double TopoProfile::operator() (double x) const {
+
+    //segment containing the point, or the end segment for extrapolation
+    long n = px.size();
+    long i = std::upper_bound(px.begin(), px.end(), x) - px.begin() - 1;
+    if (i < 0) i = 0;
+    if (i > n-2) i = n-2;
+    //linear interpolation
+    double s = (pz[i+1] - pz[i])/(px[i+1] - px[i]);
+    return( pz[i] + s*(x - px[i]) );
+}
+
+TopoProfile transect_profile (const EnviRaster &r, const GridSettings &gs, const Transect &t, std::vector<double> &x, std::vector<double> &z) {
+
+    if (gs.tpath == "greatcircle") r.great_circle_transect(t.e0, t.n0, t.e1, t.n1, gs.tnpts, x, z);
+    else r.straight_transect(t.e0, t.n0, t.e1, t.n1, gs.tnpts, x, z);
+    for (unsigned long i=0; i<x.size(); i++) x[i] += gs.ts0;
+
+    return( TopoProfile(x, z) );
+}
+
+Transect offset_transect (const Transect &t, double d) {
+
+    double de = t.e1 - t.e0, dn = t.n1 - t.n0;
+    double L = sqrt(de*de + dn*dn);
+    //unit vector to the left of the transect
+    double le = -dn/L, ln = de/L;
+    Transect o = {t.name, t.e0 + d*le, t.n0 + d*ln, t.e1 + d*le, t.n1 + d*ln};
+
+    return(o);
+}
+
+std::vector<TopoProfile> grid_rows (const GridSettings &gs, const EnviRaster *r, const Transect &t, const TopoProfile &f, std::vector<double> &ye) {
+
+    std::vector<TopoProfile> rows;
+    ye.clear();
+    if (gs.Ny == 0) {
+        rows.push_back(f);
+        return(rows);
+    }
+
+    //evenly spaced rows
+    for (long i=0; i<=gs.Ny; i++) ye.push_back(gs.ya + (gs.yb - gs.ya)*double(i)/double(gs.Ny));
+    ye[gs.Ny] = gs.yb;
+    for (long i=0; i<gs.Ny; i++) {
+        double y = (ye[i] + ye[i+1])/2.0;
+        if (r != NULL) {
+            //parallel transects through the raster
+            std::vector<double> x, z;
+            rows.push_back(transect_profile(*r, gs, offset_transect(t, y), x, z));
+        } else {
+            //the same profile, tilted across the rows
+            std::vector<double> z(f.pz);
+            for (unsigned long n=0; n<z.size(); n++) z[n] += gs.yslope*y;
+            rows.push_back(TopoProfile(f.px, z));
+        }
+    }
+
+    return(rows);
+}
+
+//------------------------------------------------------------------------------
+//grid construction
+
+//divides without failing on zero, like div0 in generate_grid.py
+static double div0 (double a, double b) {
+    if (b != 0.0) return(a/b);
+    return(INFINITY);
+}
+
+std::vector<double> refine_grid (double xa, double xb, long Nx0, double zrange, const TopoProfile &f, double g0, double g1, double g2) {
+
+    //initial evenly spaced points, computed like numpy.linspace
+    std::vector<double> x0(Nx0);
+    double step = (xb - xa)/double(Nx0 - 1);
+    for (long i=0; i<Nx0; i++) x0[i] = double(i)*step + xa;
+    x0[Nx0-1] = xb;
+    //finite difference steps for the slope and curvature
+    double delx0 = (x0[1] - x0[0])/1e3;
+    double h = (xb - xa)/1e6;
+
+    //refine each starting interval depth first, the stack holds intervals
+    //with the leftmost on top, so edges come out in order
+    std::vector<double> xe;
+    std::vector< std::pair<double,double> > stack;
+    xe.push_back(x0[0]);
+    for (long i=0; i<Nx0-1; i++) {
+        stack.push_back(std::make_pair(x0[i], x0[i+1]));
+        while (!stack.empty()) {
+            double a = stack.back().first, b = stack.back().second;
+            stack.pop_back();
+            //the tests of refined_grid()
+            double xm = a/2 + b/2;
+            double rho = 1.0/(b - a);
+            double c0 = div0(rho*zrange, fabs(f(b) - f(a)));
+            double c1 = div0(rho, fabs((f(xm + h) - f(xm - h))/(2*h)));
+            double c2 = div0(rho, fabs((f(xm - delx0) - 2*f(xm) + f(xm + delx0))/(delx0*delx0)));
+            if ( (c0 < g0) || (c1 < g1) || (c2 < g2) ) {
+                //bisect, left half on top
+                stack.push_back(std::make_pair(xm, b));
+                stack.push_back(std::make_pair(a, xm));
+            } else {
+                //done with the interval
+                xe.push_back(b);
+            }
+        }
+    }
+
+    return(xe);
+}
+
+std::vector<double> smooth_grid (const std::vector<double> &xe) {
+
+    //cells as a linked list, with the edges of each cell
+    std::vector<double> lo, hi;
+    std::vector<long> prv, nxt, ver;
+    long n = xe.size() - 1;
+    for (long i=0; i<n; i++) {
+        lo.push_back(xe[i]);
+        hi.push_back(xe[i+1]);
+        prv.push_back(i-1);
+        nxt.push_back(i+1 < n ? i+1 : -1);
+        ver.push_back(0);
+    }
+
+    //queue of cells by size, entries are stale if the cell changed since
+    typedef std::pair< double, std::pair<long,long> > entry;
+    std::priority_queue<entry> q;
+    for (long i=0; i<n; i++)
+        q.push(entry(hi[i] - lo[i], std::make_pair(i, 0L)));
+
+    while (!q.empty()) {
+        long i = q.top().second.first;
+        long v = q.top().second.second;
+        q.pop();
+        if (v != ver[i]) continue;
+        //compare with the neighbors as generate_grid.py does, the ratio of
+        //the left cell to the right cell
+        double d = hi[i] - lo[i];
+        bool split = false;
+        if ( (prv[i] >= 0) && ((hi[prv[i]] - lo[prv[i]])/d < 1/2.001) ) split = true;
+        if ( (nxt[i] >= 0) && (d/(hi[nxt[i]] - lo[nxt[i]]) > 2.001) ) split = true;
+        if (!split) continue;
+        //bisect the cell, the new cell is the right half
+        long m = lo.size();
+        double xm = hi[i]/2 + lo[i]/2;
+        lo.push_back(xm);
+        hi.push_back(hi[i]);
+        prv.push_back(i);
+        nxt.push_back(nxt[i]);
+        ver.push_back(0);
+        if (nxt[i] >= 0) prv[nxt[i]] = m;
+        nxt[i] = m;
+        hi[i] = xm;
+        ver[i]++;
+        //queue both halves and the neighbors, which might now be too large
+        q.push(entry(hi[i] - lo[i], std::make_pair(i, ver[i])));
+        q.push(entry(hi[m] - lo[m], std::make_pair(m, 0L)));
+        if (prv[i] >= 0) {
+            ver[prv[i]]++;
+            q.push(entry(hi[prv[i]] - lo[prv[i]], std::make_pair(prv[i], ver[prv[i]])));
+        }
+        if (nxt[m] >= 0) {
+            ver[nxt[m]]++;
+            q.push(entry(hi[nxt[m]] - lo[nxt[m]], std::make_pair(nxt[m], ver[nxt[m]])));
+        }
+    }
+
+    //walk the list for the edges
+    std::vector<double> xs;
+    long i = 0;
+    xs.push_back(lo[i]);
+    while (i >= 0) {
+        xs.push_back(hi[i]);
+        i = nxt[i];
+    }
+
+    return(xs);
+}
+
+std::vector<double> depth_edges (double zdepth, double delz0, double fdelz) {
+
+    //grow downward from the surface
+    std::vector<double> d;
+    d.push_back(0.0);
+    d.push_back(delz0);
+    while (d.back() < zdepth) {
+        long n = d.size();
+        d.push_back( d[n-1] + fdelz*(d[n-1] - d[n-2]) );
+    }
+    d.back() = zdepth;
+    //flip into elevations, increasing upward
+    std::vector<double> ze(d.size());
+    for (unsigned long i=0; i<d.size(); i++)
+        ze[i] = -d[d.size()-1-i];
+
+    return(ze);
+}
+
+void write_grid (const std::string &griddir, const std::vector<double> &xe, const std::vector<double> &ze, const TopoProfile &f) {
+    write_grid(griddir, xe, ze, std::vector<double>(), std::vector<TopoProfile>(1, f));
+}
+
+void write_grid (const std::string &griddir, const std::vector<double> &xe, const std::vector<double> &ze, const std::vector<double> &ye, const std::vector<TopoProfile> &rows) {
+
+    //make the directory if necessary
+    mkdir(griddir.c_str(), 0755);
+
+    //horizontal cells and topography, row by row
+    long Nx = xe.size() - 1, Ny = rows.size();
+    std::vector<double> xc(Nx), delx(Nx), ztopc(Ny*Nx), ztope(Ny*(Nx+1));
+    for (long j=0; j<Nx; j++) {
+        xc[j] = (xe[j+1] + xe[j])/2.0;
+        delx[j] = xe[j+1] - xe[j];
+    }
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<Nx; j++)
+            ztopc[r*Nx + j] = rows[r](xc[j]);
+        for (long j=0; j<=Nx; j++)
+            ztope[r*(Nx+1) + j] = rows[r](xe[j]);
+    }
+
+    //vertical cells
+    long Nz = ze.size() - 1;
+    std::vector<double> zc(Nz), delz(Nz);
+    for (long i=0; i<Nz; i++) {
+        delz[i] = ze[i+1] - ze[i];
+        zc[i] = ze[i] + delz[i]/2.0;
+    }
+
+    //write the files BousThermGrid reads
+    write_one_long(griddir + '/' + "Nx.txt", Nx);
+    write_double_vec(griddir + '/' + "xe", xe);
+    write_double_vec(griddir + '/' + "xc", xc);
+    write_double_vec(griddir + '/' + "delx", delx);
+    write_one_long(griddir + '/' + "Nz.txt", Nz);
+    write_double_vec(griddir + '/' + "ze", ze);
+    write_double_vec(griddir + '/' + "zc", zc);
+    write_double_vec(griddir + '/' + "delz", delz);
+    write_double_vec(griddir + '/' + "ztope", ztope);
+    write_double_vec(griddir + '/' + "ztopc", ztopc);
+    //and the rows of a map-view grid
+    if (ye.size() > 0) {
+        std::vector<double> yc(Ny), dely(Ny);
+        for (long r=0; r<Ny; r++) {
+            yc[r] = (ye[r+1] + ye[r])/2.0;
+            dely[r] = ye[r+1] - ye[r];
+        }
+        write_one_long(griddir + '/' + "Ny.txt", Ny);
+        write_double_vec(griddir + '/' + "ye", ye);
+        write_double_vec(griddir + '/' + "yc", yc);
+        write_double_vec(griddir + '/' + "dely", dely);
+    }
+}
+
+void coarsen_grid (const std::string &griddir, const std::string &dirc, long fx, long fz) {
+
+    mkdir(dirc.c_str(), 0755);
+
+    //original grid
+    std::vector<double> xe = read_double_vec(griddir + "/xe"),
+                        ze = read_double_vec(griddir + "/ze"),
+                        ztope = read_double_vec(griddir + "/ztope"),
+                        ztopc = read_double_vec(griddir + "/ztopc");
+    long Nx = xe.size() - 1, Nz = ze.size() - 1;
+    long Ny = ztopc.size()/Nx;
+
+    //indices of the remaining horizontal edges, every fx-th counting from the
+    //lowest edge, which has to stay because the surface temperature lapse is
+    //measured from it
+    long jlow = std::min_element(ztope.begin(), ztope.end()) - ztope.begin();
+    jlow %= Nx + 1;
+    std::vector<long> jx(1, 0);
+    for (long j=jlow%fx; j<Nx; j+=fx) if (j > 0) jx.push_back(j);
+    jx.push_back(Nx);
+    //and of the remaining vertical edges, from the surface down
+    std::vector<long> iz;
+    for (long i=Nz; i>0; i-=fz) iz.push_back(i);
+    iz.push_back(0);
+    std::reverse(iz.begin(), iz.end());
+
+    //horizontal cells and topography
+    long Nxc = jx.size() - 1;
+    std::vector<double> xec(Nxc+1), xcc(Nxc), delxc(Nxc), ztopec(Ny*(Nxc+1)), ztopcc(Ny*Nxc);
+    for (long J=0; J<=Nxc; J++) xec[J] = xe[jx[J]];
+    for (long J=0; J<Nxc; J++) {
+        xcc[J] = (xec[J+1] + xec[J])/2.0;
+        delxc[J] = xec[J+1] - xec[J];
+    }
+    for (long r=0; r<Ny; r++) {
+        for (long J=0; J<=Nxc; J++) ztopec[r*(Nxc+1) + J] = ztope[r*(Nx+1) + jx[J]];
+        for (long J=0; J<Nxc; J++) {
+            double z = 0.0;
+            for (long j=jx[J]; j<jx[J+1]; j++) z += ztopc[r*Nx + j]*(xe[j+1] - xe[j]);
+            ztopcc[r*Nxc + J] = z/delxc[J];
+        }
+    }
+
+    //vertical cells
+    long Nzc = iz.size() - 1;
+    std::vector<double> zec(Nzc+1), zcc(Nzc), delzc(Nzc);
+    for (long I=0; I<=Nzc; I++) zec[I] = ze[iz[I]];
+    for (long I=0; I<Nzc; I++) {
+        delzc[I] = zec[I+1] - zec[I];
+        zcc[I] = zec[I] + delzc[I]/2.0;
+    }
+
+    //write the files BousThermGrid reads, with the rows unchanged
+    write_one_long(dirc + '/' + "Nx.txt", Nxc);
+    write_double_vec(dirc + '/' + "xe", xec);
+    write_double_vec(dirc + '/' + "xc", xcc);
+    write_double_vec(dirc + '/' + "delx", delxc);
+    write_one_long(dirc + '/' + "Nz.txt", Nzc);
+    write_double_vec(dirc + '/' + "ze", zec);
+    write_double_vec(dirc + '/' + "zc", zcc);
+    write_double_vec(dirc + '/' + "delz", delzc);
+    write_double_vec(dirc + '/' + "ztope", ztopec);
+    write_double_vec(dirc + '/' + "ztopc", ztopcc);
+    if (file_exists(griddir, "Ny.txt")) {
+        write_one_long(dirc + '/' + "Ny.txt", Ny);
+        write_double_vec(dirc + '/' + "ye", read_double_vec(griddir + "/ye"));
+        write_double_vec(dirc + '/' + "yc", read_double_vec(griddir + "/yc"));
+        write_double_vec(dirc + '/' + "dely", read_double_vec(griddir + "/dely"));
+    }
+}
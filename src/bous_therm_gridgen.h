@@ -0,0 +1,202 @@
+#ifndef BOUS_THERM_GRIDGEN_H_
+#define BOUS_THERM_GRIDGEN_H_
+
+//! \file bous_therm_gridgen.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <queue>
+#include <algorithm>
+
+#include "bous_therm_io.h"
+#include "bous_therm_settings.h"
+#include "bous_therm_envi.h"
+
+//------------------------------------------------------------------------------
+//settings
+
+//!container struct for the settings of a grid generation, mirroring the inputs of generate_grid.py
+struct GridSettings {
+
+    //!starting number of evenly spaced points in x
+    long Nx0;
+    //!lower x domain boundary (m)
+    double xa;
+    //!upper x domain boundary (m)
+    double xb;
+    //!refinement threshold for vertical differences between points
+    double G0;
+    //!refinement threshold for slope
+    double G1;
+    //!refinement threshold for curvature
+    double G2;
+    //!limit the change in spacing between neighboring cells to a factor of 2
+    bool smooth;
+
+    //!thickness of the z domain, which is [-zdepth, 0] (m)
+    double zdepth;
+    //!size of the smallest cell, at the surface (m)
+    double delz0;
+    //!cell size increase factor with depth
+    double fdelz;
+
+    //!binary float64 file with horizontal coordinates of the topography, empty for flat topography
+    std::string fnxtopo;
+    //!binary float64 file with elevations of the topography
+    std::string fnztopo;
+
+    //!ENVI raster to cut the topography out of instead of the profile files, empty if unused
+    std::string fnenvi;
+    //!easting of the first point of the transect (m)
+    double te0;
+    //!northing of the first point of the transect (m)
+    double tn0;
+    //!easting of the last point of the transect (m)
+    double te1;
+    //!northing of the last point of the transect (m)
+    double tn1;
+    //!number of points sampled along a transect
+    long tnpts;
+    //!transect path, "straight" in map coordinates or "greatcircle"
+    std::string tpath;
+    //!horizontal coordinate of the first point of a transect, added to the distance along it (m)
+    double ts0;
+    //!file of transects (see read_transects) to build a grid for each, in subdirectories of the grid directory, empty for a single grid
+    std::string fntransects;
+
+    //!number of rows of a map-view grid, 0 for a transect
+    long Ny;
+    //!lower y domain boundary of a map-view grid (m)
+    double ya;
+    //!upper y domain boundary of a map-view grid (m)
+    double yb;
+    //!elevation change per unit y added to profile or flat topography on the rows of a map-view grid
+    double yslope;
+};
+
+//!parses a grid settings file (see GridSettings), with the defaults of generate_grid.py
+GridSettings parse_grid_settings ( std::vector< std::vector< std::string > > sv );
+
+//------------------------------------------------------------------------------
+//topography
+
+//!piecewise linear topography profile, extrapolated linearly beyond its ends like interp1d in generate_grid.py
+class TopoProfile {
+
+public:
+
+    //!constructs a flat profile at zero elevation
+    TopoProfile ();
+    //!constructs a profile from points, which are sorted by x if necessary
+    /*!
+    \param[in] x horizontal coordinates
+    \param[in] z elevations
+    */
+    TopoProfile (const std::vector<double> &x, const std::vector<double> &z);
+
+    //!evaluates the profile at a point
+    double operator() (double x) const;
+
+    //!horizontal coordinates
+    std::vector<double> px;
+    //!elevations
+    std::vector<double> pz;
+};
+
+//!cuts a topography profile out of an ENVI raster along a transect
+/*!
+The horizontal coordinate of the profile is the distance along the transect plus GridSettings::ts0, so the grid bounds xa and xb are in the same coordinate.
+\param[in] r raster
+\param[in] gs grid settings, for the number of points, the path, and the offset
+\param[in] t transect
+\param[out] x horizontal coordinates of the samples
+\param[out] z elevations of the samples
+*/
+TopoProfile transect_profile (const EnviRaster &r, const GridSettings &gs, const Transect &t, std::vector<double> &x, std::vector<double> &z);
+
+//!moves a transect sideways in map coordinates, to the left looking from its first point to its last
+/*!
+\param[in] t transect
+\param[in] d distance (m), negative to the right
+*/
+Transect offset_transect (const Transect &t, double d);
+
+//!topography of every row of a grid, a single row for a transect
+/*!
+The rows of a map-view grid are evenly spaced between GridSettings::ya and GridSettings::yb. Cut out of a raster, each row is the transect moved sideways by the y of the row center (see offset_transect()). Otherwise every row is the same profile, tilted across the rows by GridSettings::yslope.
+\param[in] gs grid settings
+\param[in] r raster, NULL if the topography isn't cut out of one
+\param[in] t transect through the raster, along y = 0
+\param[in] f topography of the transect, or the profile or flat topography
+\param[out] ye row edges, empty for a transect
+\return topography of each row
+*/
+std::vector<TopoProfile> grid_rows (const GridSettings &gs, const EnviRaster *r, const Transect &t, const TopoProfile &f, std::vector<double> &ye);
+
+//------------------------------------------------------------------------------
+//grid construction
+
+//!refines an evenly spaced grid where the topography changes quickly
+/*!
+Every interval is bisected until it passes the three tests of refined_grid() in generate_grid.py, on the elevation difference across it and the slope and curvature at its midpoint. The tests of an interval don't depend on any other interval, so each initial interval is refined depth first with a stack, producing the sorted edges in a single pass without searching or sorting.
+\param[in] xa lower edge of the domain
+\param[in] xb upper edge of the domain
+\param[in] Nx0 number of evenly spaced points to start with
+\param[in] zrange range of elevation used to scale the first test
+\param[in] f topography
+\param[in] g0 threshold for elevation differences
+\param[in] g1 threshold for slope
+\param[in] g2 threshold for curvature
+\return cell edges
+*/
+std::vector<double> refine_grid (double xa, double xb, long Nx0, double zrange, const TopoProfile &f, double g0, double g1, double g2);
+
+//!bisects cells until no cell is more than twice the size of a neighbor
+/*!
+Cells are taken from a priority queue, largest first, and bisected if they're more than 2.001 times larger than a neighbor. Splitting a cell can only create a violation with a larger neighbor, which is queued again, so every cell is handled a bounded number of times. The result is the same as the restarting scan of generate_grid.py, which is the coarsest refinement with the factor of 2 limit.
+\param[in] xe cell edges
+\return smoothed cell edges
+*/
+std::vector<double> smooth_grid (const std::vector<double> &xe);
+
+//!creates the vertical cell edges, growing geometrically from the surface
+/*!
+\param[in] zdepth thickness of the domain (m)
+\param[in] delz0 size of the top cell (m)
+\param[in] fdelz growth factor of cell size with depth
+\return cell edges from -zdepth up to 0
+*/
+std::vector<double> depth_edges (double zdepth, double delz0, double fdelz);
+
+//!writes every grid file read by BousThermGrid
+/*!
+\param[in] griddir grid directory, created if it doesn't exist
+\param[in] xe horizontal cell edges
+\param[in] ze vertical cell edges
+\param[in] f topography
+*/
+void write_grid (const std::string &griddir, const std::vector<double> &xe, const std::vector<double> &ze, const TopoProfile &f);
+
+//!writes every grid file read by BousThermGrid, for a map-view grid if there are row edges
+/*!
+\param[in] griddir grid directory, created if it doesn't exist
+\param[in] xe horizontal cell edges
+\param[in] ze vertical cell edges
+\param[in] ye row edges, empty for a transect
+\param[in] rows topography of each row (see grid_rows())
+*/
+void write_grid (const std::string &griddir, const std::vector<double> &xe, const std::vector<double> &ze, const std::vector<double> &ye, const std::vector<TopoProfile> &rows);
+
+//!writes a coarser version of a grid by merging neighboring cells
+/*!
+Groups of fx horizontal cells are merged, aligned so the lowest edge of the topography stays an edge, and groups of fz vertical cells are merged from the surface, with any remainders in the cells on the boundaries, so every coarse edge is also an edge of the original grid and the topography is measured from the same lowest point. The topography at the remaining edges is kept and the topography of a merged cell is the width weighted mean of its cells. Rows of map-view grids aren't merged.
+\param[in] griddir original grid directory
+\param[in] dirc coarse grid directory, created if it doesn't exist
+\param[in] fx number of horizontal cells merged into one
+\param[in] fz number of vertical cells merged into one
+*/
+void coarsen_grid (const std::string &griddir, const std::string &dirc, long fx, long fz);
+
+#endif
@@ -39,6 +39,15 @@ void check_file_read (const char *fn) {
     fclose(ofile);
 }
 
+bool file_exists (const std::string &dir, const char *fn) {
+    std::string path = dir + "/" + fn;
+    FILE* ifile;
+    ifile = fopen(path.c_str(), "r");
+    if (ifile == NULL) return(false);
+    fclose(ifile);
+    return(true);
+}
+
 long read_one_long (const std::string &d, const char *fn){
 
     std::string path = d + "/" + fn;
@@ -71,6 +80,22 @@ double *alloc_read_double (const std::string &dir, const char *fn, double *a, lo
     return(a);
 }
 
+std::vector<double> read_double_vec (const std::string &fn) {
+    check_file_read(fn.c_str());
+    FILE* ifile = fopen(fn.c_str(), "rb");
+    //size of the file in doubles
+    fseek(ifile, 0, SEEK_END);
+    long n = ftell(ifile)/sizeof(double);
+    fseek(ifile, 0, SEEK_SET);
+    std::vector<double> v(n);
+    if ( long(fread(v.data(), sizeof(double), n, ifile)) != n ) {
+        std::cout << "FAILURE: unable to read file " << fn << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fclose(ifile);
+    return(v);
+}
+
 std::vector< std::vector< std::string > > read_settings_file (const char *fn) {
 
     std::vector< std::vector< std::string > > S;
@@ -138,6 +163,166 @@ void write_doubles(const std::string &fn, double **a, long n, long m) {
     fclose(ofile);
 }
 
+void write_floats (const std::string &fn, float **a, long n, long m) {
+    FILE* ofile;
+    check_file_write(fn.c_str());
+    ofile = fopen(fn.c_str(), "wb");
+    for (long i=0; i<n; i++)
+        fwrite(a[i], sizeof(float), m, ofile);
+    fclose(ofile);
+}
+
+void write_bytes (const std::string &fn, unsigned char **a, long n, long m) {
+    FILE* ofile;
+    check_file_write(fn.c_str());
+    ofile = fopen(fn.c_str(), "wb");
+    for (long i=0; i<n; i++)
+        fwrite(a[i], sizeof(unsigned char), m, ofile);
+    fclose(ofile);
+}
+
+void write_field (const std::string &fn, double **a, long n, long m) {
+    write_doubles(fn, a, n, m);
+}
+
+void write_field (const std::string &fn, float **a, long n, long m) {
+    write_floats(fn, a, n, m);
+}
+
+void write_field (const std::string &fn, unsigned char **a, long n, long m) {
+    write_bytes(fn, a, n, m);
+}
+
+const char *dtype_tag (double *a) {
+    (void)a;
+    return("float64");
+}
+
+const char *dtype_tag (float *a) {
+    (void)a;
+    return("float32");
+}
+
+const char *dtype_tag (unsigned char *a) {
+    (void)a;
+    return("uint8frac");
+}
+
+void write_one_long (const std::string &fn, long i) {
+    check_file_write(fn.c_str());
+    std::ofstream ofile(fn.c_str());
+    ofile << i;
+}
+
 void write_double_vec (const std::string &fn, std::vector<double> v) {
     write_double(fn, v.data(), v.size());
 }
+
+//------------------------------------------------------------------------------
+//DELTA ENCODING
+
+//marks the start of a delta encoded file
+static const char delta_magic[9] = "BTDELTA1";
+
+void delta_encode (const unsigned char *a, const unsigned char *ref, long n, int w, std::vector<unsigned char> &out) {
+
+    //XOR with the reference, shuffled into byte planes
+    long nb = n*w;
+    std::vector<unsigned char> x(nb);
+    for (long e=0; e<n; e++)
+        for (int b=0; b<w; b++)
+            x[b*n + e] = ref ? (a[e*w + b] ^ ref[e*w + b]) : a[e*w + b];
+
+    //runs of three or more equal bytes are repeats, everything else literals
+    out.clear();
+    long i = 0;
+    while (i < nb) {
+        long r = 1;
+        while ( (i + r < nb) && (r < 130) && (x[i+r] == x[i]) ) r++;
+        if (r >= 3) {
+            out.push_back((unsigned char)(r + 125));
+            out.push_back(x[i]);
+            i += r;
+        } else {
+            //literals up to the next run of three
+            long j = i;
+            while ( (j < nb) && (j - i < 128) && !( (j + 2 < nb) && (x[j] == x[j+1]) && (x[j] == x[j+2]) ) ) j++;
+            out.push_back((unsigned char)(j - i - 1));
+            out.insert(out.end(), x.begin() + i, x.begin() + j);
+            i = j;
+        }
+    }
+}
+
+bool delta_decode (const unsigned char *in, long nin, const unsigned char *ref, long n, int w, unsigned char *a) {
+
+    //undo the run length coding
+    long nb = n*w;
+    std::vector<unsigned char> x(nb);
+    long i = 0, k = 0;
+    while (i < nin) {
+        int c = in[i++];
+        if (c < 128) {
+            if ( (k + c + 1 > nb) || (i + c + 1 > nin) ) return(false);
+            for (int j=0; j<=c; j++) x[k++] = in[i++];
+        } else {
+            if ( (k + c - 125 > nb) || (i >= nin) ) return(false);
+            for (int j=0; j<c-125; j++) x[k++] = in[i];
+            i++;
+        }
+    }
+    if (k != nb) return(false);
+
+    //unshuffle and undo the XOR
+    for (long e=0; e<n; e++)
+        for (int b=0; b<w; b++)
+            a[e*w + b] = ref ? (x[b*n + e] ^ ref[e*w + b]) : x[b*n + e];
+    return(true);
+}
+
+void write_delta (const std::string &fn, const unsigned char *a, const unsigned char *ref, long n, int w) {
+    std::vector<unsigned char> enc;
+    delta_encode(a, ref, n, w, enc);
+    uint32_t head[2] = {uint32_t(w), uint32_t(ref == NULL)};
+    uint64_t size[2] = {uint64_t(n), uint64_t(enc.size())};
+    FILE* ofile;
+    check_file_write(fn.c_str());
+    ofile = fopen(fn.c_str(), "wb");
+    fwrite(delta_magic, 1, 8, ofile);
+    fwrite(head, sizeof(uint32_t), 2, ofile);
+    fwrite(size, sizeof(uint64_t), 2, ofile);
+    fwrite(enc.data(), 1, enc.size(), ofile);
+    fclose(ofile);
+}
+
+bool read_delta (const std::string &fn, const std::vector<unsigned char> &ref, std::vector<unsigned char> &a, int *w) {
+
+    check_file_read(fn.c_str());
+    FILE* ifile = fopen(fn.c_str(), "rb");
+    char magic[8];
+    uint32_t head[2];
+    uint64_t size[2];
+    if ( (fread(magic, 1, 8, ifile) != 8) || (std::string(magic, 8) != delta_magic) ) {
+        fclose(ifile);
+        return(false);
+    }
+    std::vector<unsigned char> enc;
+    bool ok = (fread(head, sizeof(uint32_t), 2, ifile) == 2) && (fread(size, sizeof(uint64_t), 2, ifile) == 2);
+    if (ok) {
+        enc.resize(size[1]);
+        ok = (fread(enc.data(), 1, size[1], ifile) == size[1]);
+    }
+    fclose(ifile);
+    //a delta needs the previous snap of the same size
+    if ( ok && !head[1] ) ok = (ref.size() == size[0]*head[0]);
+    if (ok) {
+        a.resize(size[0]*head[0]);
+        ok = delta_decode(enc.data(), enc.size(), head[1] ? NULL : ref.data(), size[0], head[0], a.data());
+    }
+    if (!ok) {
+        std::cout << "FAILURE: delta encoded file " << fn << " is corrupt or its previous snap is missing" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    *w = head[0];
+    return(true);
+}
@@ -36,6 +36,14 @@ void split_string (char c, std::string &s, std::string &s1, std::string &s2);
 */
 void check_file_read (const char *fn);
 
+//!checks if a file exists and can be opened for reading, without failing
+/*!
+\param[in] dir directory of target file
+\param[in] fn name of target file
+\return true if the file can be opened
+*/
+bool file_exists (const std::string &dir, const char *fn);
+
 //!reads a single integer out of a file and into a long type
 /*!
 \param[in] dir directory of target file
@@ -62,6 +70,13 @@ void read_double (const std::string &dir, const std::string &fn, double *a, long
 */
 double *alloc_read_double(const std::string &dir, const char *fn, double *a, long size);
 
+//!reads a whole binary file of doubles into a vector
+/*!
+\param[in] fn path to the file
+\return all the numbers in the file
+*/
+std::vector<double> read_double_vec (const std::string &fn);
+
 //!a special function for reading a settings file into a vector of vectors of strings
 std::vector< std::vector< std::string > > read_settings_file (const char *fn);
 
@@ -88,6 +103,49 @@ void write_double (const std::string &fn, double *a, long size);
 */
 void write_doubles (const std::string &fn, double **a, long n, long m);
 
+//!writes a group of equally sized arrays of floats to a single file
+/*!
+\param[in] fn target file path
+\param[in] a array of pointers to equally sized arrays of floats
+\param[in] n length of a
+\param[in] m length of arrays in a
+*/
+void write_floats (const std::string &fn, float **a, long n, long m);
+
+//!writes a group of equally sized arrays of bytes to a single file
+/*!
+\param[in] fn target file path
+\param[in] a array of pointers to equally sized arrays of bytes
+\param[in] n length of a
+\param[in] m length of arrays in a
+*/
+void write_bytes (const std::string &fn, unsigned char **a, long n, long m);
+
+//!writes a two-dimensional field of doubles (see write_doubles())
+void write_field (const std::string &fn, double **a, long n, long m);
+
+//!writes a two-dimensional field of floats (see write_floats())
+void write_field (const std::string &fn, float **a, long n, long m);
+
+//!writes a two-dimensional field of bytes (see write_bytes())
+void write_field (const std::string &fn, unsigned char **a, long n, long m);
+
+//!names the numpy data type of an array of doubles
+const char *dtype_tag (double *a);
+
+//!names the numpy data type of an array of floats
+const char *dtype_tag (float *a);
+
+//!names the data type of an array of fractions stored as bytes in increments of 1/255
+const char *dtype_tag (unsigned char *a);
+
+//!writes a single integer into a text file
+/*!
+\param[in] fn target file path
+\param[in] i integer to write
+*/
+void write_one_long (const std::string &fn, long i);
+
 //!writes a vector of doubles to a binary file
 /*!
 \param[in] fn target file path
@@ -95,4 +153,51 @@ void write_doubles (const std::string &fn, double **a, long n, long m);
 */
 void write_double_vec (const std::string &fn, std::vector<double> v);
 
+//------------------------------------------------------------------------------
+//DELTA ENCODING
+
+//!encodes an array as the XOR of its bytes with a reference, shuffled into byte planes and run length coded
+/*!
+Successive snaps of a field are nearly identical over most of the domain, so the XOR of an array with the previous snap is mostly zero bytes, and where values did change, the bytes holding the sign, exponent, and leading mantissa usually didn't. The XOR is shuffled so the first byte of every element comes first, then the second byte of every element, and so on, which puts those zeros into long runs, and the shuffled bytes are run length coded with the PackBits scheme: a control byte c below 128 is followed by c+1 literal bytes, and a control byte of 128 or more is followed by one byte repeated c-125 times. Decoding is exact.
+\param[in] a bytes of the array
+\param[in] ref bytes of the reference array, or NULL to encode the array by itself
+\param[in] n number of elements
+\param[in] w size of each element in bytes
+\param[out] out encoded bytes
+*/
+void delta_encode (const unsigned char *a, const unsigned char *ref, long n, int w, std::vector<unsigned char> &out);
+
+//!decodes bytes written by delta_encode()
+/*!
+\param[in] in encoded bytes
+\param[in] nin number of encoded bytes
+\param[in] ref bytes of the reference array, or NULL if the array was encoded by itself
+\param[in] n number of elements
+\param[in] w size of each element in bytes
+\param[out] a bytes of the array, n*w of them
+\return whether the encoded bytes decoded into exactly n*w bytes
+*/
+bool delta_decode (const unsigned char *in, long nin, const unsigned char *ref, long n, int w, unsigned char *a);
+
+//!writes a delta encoded array to a file
+/*!
+The file starts with the 8 characters BTDELTA1, then the element size and whether the array was encoded by itself (a key) as 32 bit integers, then the number of elements and the number of encoded bytes as 64 bit integers, then the encoded bytes.
+\param[in] fn target file path
+\param[in] a bytes of the array
+\param[in] ref bytes of the reference array, or NULL to write a key
+\param[in] n number of elements
+\param[in] w size of each element in bytes
+*/
+void write_delta (const std::string &fn, const unsigned char *a, const unsigned char *ref, long n, int w);
+
+//!reads a file written by write_delta()
+/*!
+\param[in] fn path to file
+\param[in] ref bytes of the reference array, the previous snap of the field, ignored for a key
+\param[out] a bytes of the array
+\param[out] w size of each element in bytes
+\return false if the file isn't delta encoded, in which case a is untouched
+*/
+bool read_delta (const std::string &fn, const std::vector<unsigned char> &ref, std::vector<unsigned char> &a, int *w);
+
 #endif
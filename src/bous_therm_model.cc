@@ -1,5 +1,10 @@
 //! \file bous_therm_model.cc
 
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
+
 #include "bous_therm_model.h"
 
 //------------------------------------------------------------------------------
@@ -15,79 +20,395 @@ BousThermModel::BousThermModel (const std::string &griddir_, long neq_, Settings
     dirout = dirout_;
     //bind the settings structure
     stg = stg_;
-    //solution vector to zero at the beginning
-    for (long i=0; i<long(get_neq()); i++)
-        set_sol(i, 0.0);
 
     //alias the ode solution array, which is buried under many classes
     H = get_sol(); //water table
-    T = new double*[Nx+1]; //temperature profiles
-    for (long j=0; j<Nx+1; j++)
-        T[j] = get_sol() + Nx + Nz*j; //pointer arithmetic
+    T = new double*[Ncol]; //temperature profiles
+    for (long k=0; k<Ncol; k++)
+        T[k] = get_sol() + Ncell + Nz*k; //pointer arithmetic
 
     //allocate space for ode aliases
-    Tin = new double*[Nx+1];
-    dTdt = new double*[Nx+1];
+    Tin = new double*[Ncol];
+    dTdt = new double*[Ncol];
 
     //------------------------------------------------------------------
     //get anything from the settings struct
 
-    ktherm = stg->kTr;
-
-    //------------------------------------------------------------------
-
-    //initial temperature profile
-    for (long j=0; j<Nx+1; j++)
-        for (long i=0; i<Nz; i++)
-            T[j][i] = f_surf_temp(get_t(), htope[j], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR) - stg->fTgeo*zc[i]/ktherm;
+    //time stepping method
+    if ( cmp(stg->integrator.c_str(), "trapz") ) {
+        integrator = TRAPZ;
+    } else if ( cmp(stg->integrator.c_str(), "rkc") ) {
+        integrator = RKC;
+        nrho = stg->nrho;
+        std::cout << "using the Runge-Kutta-Chebyshev integrator" << std::endl;
+    } else if ( cmp(stg->integrator.c_str(), "lts") ) {
+        integrator = LTS;
+        std::cout << "using local time stepping of the thermal columns" << std::endl;
+        if (stg->implicitH) {
+            std::cout << "FAILURE: local time stepping can't be used with the implicit water table (implicitH)" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    } else if ( cmp(stg->integrator.c_str(), "etd") ) {
+        integrator = ETD;
+        std::cout << "using exponential time differencing of the thermal columns" << std::endl;
+    } else {
+        std::cout << "FAILURE: unknown integrator: " << stg->integrator << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    //intial head profile
-    for (long j=0; j<Nx; j++) H[j] = ztopc[j] - stg->Hdep0;
+    //split the domain into tiles for the parallel loops
+    nthr = omp_get_max_threads();
+    long tnx = stg->tilenx, tny = stg->tileny;
+    if (tnx <= 0) {
+        //a transect gets many small tiles per thread so the load can be
+        //balanced finely
+        if (Ny == 1) tnx = (Ncol + 16*nthr - 1)/(16*nthr);
+        //a map-view domain gets wide tiles, shrunk until there are enough
+        else {
+            tnx = std::min(64L, Nx+1);
+            if (tny <= 0) tny = std::min(16L, Ny);
+            while ( (((Nx+tnx)/tnx)*((Ny+tny-1)/tny) < 16*nthr) && (tnx > 8 || tny > 1) ) {
+                if (tnx > 8) tnx /= 2;
+                else tny /= 2;
+            }
+        }
+    }
+    if (tny <= 0) tny = 16;
+    make_tiles(tnx, tny);
+    printf("  domain split into %li tiles\n", Ntile);
+
+    //hand out tiles to threads, in equal numbers of columns to start
+    tb = new long[nthr+1];
+    tcost = new double[Ntile];
+    tbusy = new double[nthr];
+    for (long n=0; n<Ntile; n++)
+        tcost[n] = double((tiles[n].r1 - tiles[n].r0)*(tiles[n].j1 - tiles[n].j0));
+    partition_tiles();
+    for (long n=0; n<Ntile; n++) tcost[n] = 0.0;
+    for (int t=0; t<nthr; t++) tbusy[t] = 0.0;
+    nrebal = 0;
+
+    //storage error trackers for validating mixed precision
+    perr = new double*[nthr];
+    for (int t=0; t<nthr; t++) {
+        perr[t] = new double[5];
+        for (int i=0; i<5; i++) perr[t][i] = 0.0;
+    }
 
     //------------------------------------------------------------------
 
     //static, depth dependent, physical parameters
     poro = new double[Nz];
     perm = new double[Nz];
+    set_params();
+
+    //dynamic physical parameters
+    qH = new double[Ncol];
+    qHy = new double[(Ny+1)*Nx];
+    qT = new diag_t*[Ncol];
+    Kint = new double[Ncol];
+    Tsurf = new double[Ncol];
+    aqbot = new double[Ncol];
+    wsat = new sat_t*[Ncol];
+    isat = new sat_t*[Ncol];
+    captherm = new diag_t*[Ncol];
+
+    //derivatives and such
+    gradH = new double[Ncol];
+    gradHy = new double[(Ny+1)*Nx];
+    Hedge = new double[Ncol];
+    gradT = new diag_t*[Ncol];
+
+    //no flow across the outer row faces
+    for (long c=0; c<(Ny+1)*Nx; c++) {
+        qHy[c] = 0.0;
+        gradHy[c] = 0.0;
+    }
+
+    //implicit water table solve
+    Hold = new double[Ncell];
+    hsrc = new double[Ncell];
+    hsurf = new bool[Ncell];
+    for (long c=0; c<Ncell; c++) {
+        hsrc[c] = 0.0;
+        hsurf[c] = false;
+    }
+    tdsys = new double*[nthr];
+    for (int t=0; t<nthr; t++)
+        tdsys[t] = new double[10*Nx];
+    npic_max = 0;
+    npic_fail = 0;
+
+    //local time stepping, full stage arrays only if it's used
+    qHint = new double[Ncol];
+    qH0 = new double[Ncol];
+    ltsin = NULL;
+    ltsout = NULL;
+    if (integrator == LTS) {
+        ltsin = new double[get_neq()];
+        ltsout = new double[get_neq()];
+    }
+    ltsf = new double*[nthr];
+    for (int t=0; t<nthr; t++)
+        ltsf[t] = new double[Nz];
+    nsub_sum = 0;
+    nsub_max = 0;
+    nsub_steps = 0;
+    nsub_all = 0;
+
+    //exponential time differencing, full stage arrays only if it's used
+    etdf0 = NULL;
+    etdu = NULL;
+    etdf1 = NULL;
+    if (integrator == ETD) {
+        etdf0 = new double[get_neq()];
+        etdu = new double[get_neq()];
+        etdf1 = new double[get_neq()];
+    }
+    etdcol = new double*[nthr];
+    etdz = new std::complex<double>*[nthr];
+    for (int t=0; t<nthr; t++) {
+        etdcol[t] = new double[5*Nz];
+        etdz[t] = new std::complex<double>[2*Nz];
+    }
+
+    //tracking/snapping variables
+    resumed = false;
+    evap = new double[Ncell];
+    evapw = new double[Ncell];
+    cumevap = new double[Ncell];
+    //in-situ statistics, only if they're wanted
+    stat_evap = NULL;
+    stat_minaqbot = NULL;
+    stat_maxaqbot = NULL;
+    stat_thaw = NULL;
+    stat_qH = NULL;
+    stat_Hdep = NULL;
+    if (stg->stats) {
+        if ( (stg->statbins < 1) || !(stg->statdmax > 0.0) ) {
+            std::cout << "FAILURE: statbins must be at least 1 and statdmax must be positive" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        stat_evap = new double[Ncell];
+        stat_minaqbot = new double[Ncol];
+        stat_maxaqbot = new double[Ncol];
+        stat_thaw = new double[Ncol];
+        stat_qH = new double[Ncol];
+        stat_Hdep = new double[Ncell*stg->statbins];
+    }
+    reset_stats();
+    //probes, which only record during a solve
+    precord = false;
+    init_probes();
+    //events, which are only detected during a solve
+    eHprev = NULL;
+    escr = NULL;
+    etprev = 0.0;
+    nevent = 0;
+    erecord = false;
+    init_events();
+
+    //diagnostics are only stored when they're about to be written
+    diagnose = false;
+    //the ode function starts its own team unless one is running the loop
+    team = false;
+    //stability limits are estimated before solving
+    dtlim_T = INFINITY;
+    dtlim_H = INFINITY;
+    klim_T = ilim_T = clim_H = -1;
+    fdiag = new double[get_neq()];
+    //no sensitivities unless they're set up
+    sprev = NULL;
+    sscr = NULL;
+    tprev = 0.0;
+
+    //temperatures are the state, or recovered from the enthalpy state
+    if (stg->enthalpy) {
+        std::cout << "using enthalpy formulation for phase change" << std::endl;
+        temp = new double*[Ncol];
+        nwet = new long[Ncol];
+    } else {
+        temp = T;
+    }
+    //scratch columns of temperature and liquid fraction for each thread
+    tcol = new double*[nthr];
+    lcol = new double*[nthr];
+    for (int t=0; t<nthr; t++) {
+        tcol[t] = new double[Nz];
+        lcol[t] = new double[Nz];
+    }
+
+    //------------------------------------------------------------------
+
+    //allocate column arrays and set the initial state from the threads that own them
+    first_touch();
+
+    std::cout << "model constructor finished" << std::endl;
+}
+
+void BousThermModel::first_touch () {
+
+    //the ownership of tiles here is the same as in ode_fun, so each thread
+    //writes first to the memory it will work on, placing the pages on that
+    //thread's NUMA node
+    #pragma omp parallel num_threads(nthr)
+    for (int t=omp_get_thread_num(); t<nthr; t+=omp_get_num_threads())
+    for (long n=tb[t]; n<tb[t+1]; n++) {
+        for (long r=tiles[n].r0; r<tiles[n].r1; r++) {
+            for (long j=tiles[n].j0; j<tiles[n].j1; j++) {
+                long k = r*(Nx+1) + j;
+                //column arrays
+                qT[k] = new diag_t[Nz+1];
+                gradT[k] = new diag_t[Nz+1];
+                captherm[k] = new diag_t[Nz];
+                wsat[k] = new sat_t[Nz];
+                isat[k] = new sat_t[Nz];
+                for (long i=0; i<Nz+1; i++) {
+                    qT[k][i] = 0.0;
+                    gradT[k][i] = 0.0;
+                }
+                for (long i=0; i<Nz; i++) {
+                    captherm[k][i] = 0.0;
+                    wsat[k][i] = 0.0;
+                    isat[k][i] = 0.0;
+                }
+                //edge arrays
+                qH[k] = 0.0;
+                Kint[k] = 0.0;
+                Tsurf[k] = 0.0;
+                aqbot[k] = 0.0;
+                gradH[k] = 0.0;
+                Hedge[k] = 0.0;
+                //recovered temperatures, when the state is enthalpy
+                if (stg->enthalpy) temp[k] = new double[Nz];
+                //initial state
+                init_column(r, j);
+            }
+        }
+    }
+
+    //once the whole water table is set, convert temperature to enthalpy
+    if (stg->enthalpy) {
+        #pragma omp parallel num_threads(nthr)
+        for (int t=omp_get_thread_num(); t<nthr; t+=omp_get_num_threads())
+        for (long n=tb[t]; n<tb[t+1]; n++)
+            for (long r=tiles[n].r0; r<tiles[n].r1; r++)
+                for (long j=tiles[n].j0; j<tiles[n].j1; j++)
+                    init_enthalpy(r, j);
+    }
+}
+
+void BousThermModel::set_params () {
+
+    ktherm = stg->kTr;
     for (long i=0; i<Nz; i++) {
         poro[i] = f_poro(-zc[i], stg->poro0, stg->porogam);
         perm[i] = f_perm(-zc[i], stg->perm0, stg->permgam);
     }
+    poro_surf = f_poro(0.0, stg->poro0, stg->porogam);
+}
 
-    //dynamic physical parameters
-    qH = new double[Nx+1];
-    qT = new double*[Nx+1];
-    Kint = new double[Nx+1];
-    Tsurf = new double[Nx+1];
-    aqbot = new double[Nx+1];
-    wsat = new double*[Nx+1];
-    isat = new double*[Nx+1];
-    captherm = new double*[Nx+1];
-    for (long j=0; j<Nx+1; j++) {
-        qT[j] = new double[Nz+1];
-        captherm[j] = new double[Nz];
-        wsat[j] = new double[Nz];
-        isat[j] = new double[Nz];
+void BousThermModel::init_column (long r, long j) {
+
+    long k = r*(Nx+1) + j;
+    //initial temperature profile
+    for (long i=0; i<Nz; i++)
+        T[k][i] = f_surf_temp(get_t(), htope[k], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR) - stg->fTgeo*zc[i]/ktherm;
+    if (stg->enthalpy)
+        for (long i=0; i<Nz; i++) temp[k][i] = T[k][i];
+    //cells owned by the column
+    if (j < Nx) {
+        long c = r*Nx + j;
+        //initial head profile
+        H[c] = ztopc[c] - stg->Hdep0;
+        //evaporation trackers
+        evap[c] = 0.0;
+        evapw[c] = 0.0;
+        cumevap[c] = 0.0;
     }
+}
 
-    //derivatives and such
-    gradH = new double[Nx+1];
-    Hedge = new double[Nx+1];
-    gradT = new double*[Nx+1];
-    for (long j=0; j<Nx+1; j++)
-        gradT[j] = new double[Nz+1];
+void BousThermModel::init_enthalpy (long r, long j) {
 
-    //tracking/snapping variables
-    evap = new double[Nx];
-    evapw = new double[Nx];
-    cumevap = new double[Nx];
+    long k = r*(Nx+1) + j;
+    double gH;
+    double zedge = f_Hedge(r, j, H, &gH) - ztope[k];
+    for (long i=0; i<Nz; i++)
+        T[k][i] = f_enthalpy(poro[i], T[k][i], zc[i] < zedge ? 1.0 : 0.0, 0.0);
+    nwet[k] = wet_cells(r, j);
+}
 
-    //surface porosity
-    poro_surf = f_poro(0.0, stg->poro0, stg->porogam);
+long BousThermModel::wet_cells (long r, long j) {
 
-    //------------------------------------------------------------------
+    long k = r*(Nx+1) + j;
+    double gH;
+    double zedge = f_Hedge(r, j, H, &gH) - ztope[k];
+    long n = 0;
+    while ( (n < Nz) && (zc[n] < zedge) ) n++;
+    return(n);
+}
 
-    std::cout << "model constructor finished" << std::endl;
+void BousThermModel::count_wet () {
+
+    for (long r=0; r<Ny; r++)
+        for (long j=0; j<=Nx; j++)
+            nwet[r*(Nx+1) + j] = wet_cells(r, j);
+}
+
+void BousThermModel::project_enthalpy () {
+
+    double lf;
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<=Nx; j++) {
+            long k = r*(Nx+1) + j;
+            long n = wet_cells(r, j);
+            //temperature of each crossed cell at its old saturation, then
+            //enthalpy at the new one
+            for (long i=std::min(n, nwet[k]); i<std::max(n, nwet[k]); i++) {
+                double sat = (i < nwet[k]) ? 1.0 : 0.0;
+                double Tc = f_enthalpy_temp(poro[i], T[k][i], sat, &lf);
+                T[k][i] = f_enthalpy(poro[i], Tc, 1.0 - sat, lf);
+            }
+            nwet[k] = n;
+        }
+    }
+}
+
+void BousThermModel::restart () {
+
+    //parameters and the initial state, from the settings
+    set_params();
+    set_t(0.0);
+    nstep_ = 0;
+    for (long r=0; r<Ny; r++)
+        for (long j=0; j<=Nx; j++)
+            init_column(r, j);
+    if (stg->enthalpy)
+        for (long r=0; r<Ny; r++)
+            for (long j=0; j<=Nx; j++)
+                init_enthalpy(r, j);
+    resumed = false;
+
+    //integrators and the implicit water table start over
+    reset_integrator();
+    for (long c=0; c<Ncell; c++) {
+        hsrc[c] = 0.0;
+        hsurf[c] = false;
+    }
+    npic_max = 0;
+    npic_fail = 0;
+    nsub_sum = 0;
+    nsub_max = 0;
+    nsub_steps = 0;
+    nsub_all = 0;
+
+    //nothing recorded yet
+    o_t.clear();
+    o_evap.clear();
+    o_evapw.clear();
+    o_maxaqbot.clear();
+    o_minaqbot.clear();
+    reset_stats();
 }
 
 BousThermModel::~BousThermModel () {
@@ -101,56 +422,164 @@ BousThermModel::~BousThermModel () {
     frei(perm);
     //dynamic physical
     frei(qH);
-    frei(qT, Nx+1);
+    frei(qHy);
+    frei(qT, Ncol);
     frei(Kint);
     frei(Tsurf);
     frei(aqbot);
-    frei(wsat, Nx+1);
-    frei(isat, Nx+1);
-    frei(captherm, Nx+1);
+    frei(wsat, Ncol);
+    frei(isat, Ncol);
+    frei(captherm, Ncol);
     //gradients and such
     frei(gradH);
+    frei(gradHy);
     frei(Hedge);
-    frei(gradT, Nx+1);
+    frei(gradT, Ncol);
+    //load balancing
+    frei(tb);
+    frei(tcost);
+    frei(tbusy);
+    frei(perr, nthr);
+    frei(fdiag);
+    if (stg->enthalpy) {
+        frei(temp, Ncol);
+        frei(nwet);
+    }
+    frei(tcol, nthr);
+    frei(lcol, nthr);
+    //implicit water table
+    frei(Hold);
+    frei(hsrc);
+    frei(hsurf);
+    frei(tdsys, nthr);
+    //local time stepping
+    frei(qHint);
+    frei(qH0);
+    frei(ltsin);
+    frei(ltsout);
+    frei(ltsf, nthr);
+    //exponential time differencing
+    frei(etdf0);
+    frei(etdu);
+    frei(etdf1);
+    frei(etdcol, nthr);
+    frei(etdz, nthr);
     //trakers and snappers
     frei(evap);
     frei(evapw);
     frei(cumevap);
+    //in-situ statistics
+    frei(stat_evap);
+    frei(stat_minaqbot);
+    frei(stat_maxaqbot);
+    frei(stat_thaw);
+    frei(stat_qH);
+    frei(stat_Hdep);
+    //events
+    frei(eHprev);
+    frei(escr);
+    //forward sensitivity
+    for (unsigned p=0; p<smod.size(); p++) {
+        delete smod[p];
+        delete sstg[p];
+        frei(ssol[p]);
+    }
+    frei(sprev);
+    frei(sscr);
+}
+
+//------------------------------------------------------------------------------
+//load balancing
+
+void BousThermModel::partition_tiles () {
+
+    //total cost of all tiles
+    double ctot = 0.0;
+    for (long n=0; n<Ntile; n++) ctot += tcost[n];
+
+    //cut the tiles into contiguous ranges of nearly equal cost, placing each
+    //cut on whichever side of the ideal cumulative cost is closer
+    tb[0] = 0;
+    long n = 0;
+    double csum = 0.0;
+    for (int t=1; t<nthr; t++) {
+        double target = ctot*double(t)/double(nthr);
+        while ( (n < Ntile) && (csum + tcost[n] <= target) ) {
+            csum += tcost[n];
+            n++;
+        }
+        if ( (n < Ntile) && (target - csum > csum + tcost[n] - target) ) {
+            csum += tcost[n];
+            n++;
+        }
+        tb[t] = n;
+    }
+    tb[nthr] = Ntile;
+}
+
+void BousThermModel::rebalance () {
+
+    //columns with a deep aquifer under a high water table cost the most, and
+    //the measured tile times since the last rebalance include that directly
+    double ctot = 0.0;
+    for (long n=0; n<Ntile; n++) ctot += tcost[n];
+    if (ctot > 0.0) partition_tiles();
+    //start measuring again
+    for (long n=0; n<Ntile; n++) tcost[n] = 0.0;
+    nrebal++;
+}
+
+double BousThermModel::load_imbalance () {
+
+    //busiest thread compared to the average
+    double bmax = 0.0, bsum = 0.0;
+    for (int t=0; t<nthr; t++) {
+        if (tbusy[t] > bmax) bmax = tbusy[t];
+        bsum += tbusy[t];
+    }
+    if (bsum <= 0.0) return(0.0);
+    return( bmax/(bsum/nthr) - 1.0 );
 }
 
 //------------------------------------------------------------------------------
 //monitoring functions
 
+bool BousThermModel::diag (const char *name) {
+    return( in_list(stg->diagout, name) );
+}
+
 double BousThermModel::total_evap () {
-    //get the current total evaporation rate (m^2/s)
+    //get the current total evaporation rate (m^2/s, or m^3/s in map view)
     double e = 0.0;
-    for (long j=0; j<Nx; j++) e += evap[j];
+    for (long c=0; c<Ncell; c++) e += evap[c];
     return(e);
 }
 
 double BousThermModel::total_evap_per_width () {
-    //get the current total evaporation rate (m/2)
+    //get the current total evaporation rate per evaporating width, or area in map view (m/s)
     double e = 0.0, w = 0.0;
-    for (long j=0; j<Nx; j++) {
-        if (evap[j] > 0.0) {
-            e += evap[j];
-            w += delx[j];
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<Nx; j++) {
+            if (evap[r*Nx+j] > 0.0) {
+                e += evap[r*Nx+j];
+                w += delx[j]*dely[r];
+            }
         }
     }
     return(e/w);
 }
 
 double BousThermModel::max_H_depth () {
-    double *d = new double[Nx];
-    for (long j=0; j<Nx; j++) d[j] = ztopc[j] - H[j];
-    return( max(d,Nx) );
+    double *d = new double[Ncell];
+    for (long c=0; c<Ncell; c++) d[c] = ztopc[c] - H[c];
+    return( max(d,Ncell) );
     delete [] d;
 }
 
 double BousThermModel::min_H_depth () {
-    double *d = new double[Nx];
-    for (long j=0; j<Nx; j++) d[j] = ztopc[j] - H[j];
-    return( min(d,Nx) );
+    double *d = new double[Ncell];
+    for (long c=0; c<Ncell; c++) d[c] = ztopc[c] - H[c];
+    return( min(d,Ncell) );
     delete [] d;
 }
 
@@ -220,67 +649,223 @@ double BousThermModel::f_dHdt (double fl, double fr, double po, double delx) {
     return( (fl - fr)/(delx*po) );
 }
 
+void BousThermModel::f_sat (long i, long fidx, double zedge, double aqbot, double temp, double *sw, double *si) {
+
+    if ( zc[i] < zedge ) {
+        if ( i == fidx) {
+            *si = (aqbot - ze[i])/delz[i];
+            *sw = 1.0 - *si;
+        } else {
+            if ( temp < TFREEZE ) {
+                *si = 1.0;
+                *sw = 0.0;
+            } else {
+                *si = 0.0;
+                *sw = 1.0;
+            }
+        }
+    } else {
+        *si = 0.0;
+        *sw = 0.0;
+    }
+}
+
 void BousThermModel::update_sat (double zedge, double aqbot, double *Tin, double *wsat, double *isat) {
 
     long fidx = point_inside(ze, aqbot, Nz+1);
 
+    for (long i=0; i<Nz; i++)
+        f_sat(i, fidx, zedge, aqbot, Tin[i], wsat + i, isat + i);
+}
+
+double BousThermModel::f_Hedge (long r, long j, double *Hin, double *gH) {
+
+    double He;
+    if (j == 0) {
+        //left edge
+        *gH = 0.0;
+        He = Hin[r*Nx];
+    } else if (j == Nx) {
+        //right edge
+        *gH = 0.0;
+        He = Hin[r*Nx+Nx-1];
+    } else {
+        //interior edges
+        *gH = (Hin[r*Nx+j] - Hin[r*Nx+j-1])/(xc[j] - xc[j-1]);
+        He = Hin[r*Nx+j-1] + (*gH)*(xe[j] - xc[j-1]);
+        //check the edge value is below the surface
+        if ( He > ztope[r*(Nx+1)+j] )
+            He = ztope[r*(Nx+1)+j];
+    }
+    return(He);
+}
+
+void BousThermModel::ode_column (long r, long j, double t) {
+
+    //index of the column
+    long k = r*(Nx+1) + j;
+
+    //aliases for the column's input and output
+    Tin[k] = Hin + Ncell + Nz*k;
+    dTdt[k] = dHdt + Ncell + Nz*k;
+    //surface temperature
+    Tsurf[k] = f_surf_temp(t, htope[k], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR);
+
+    //hydraulic gradient and edge value, reading neighboring cells in the row
+    double gH;
+    double He = f_Hedge(r, j, Hin, &gH);
+    if (diagnose) {
+        gradH[k] = gH;
+        Hedge[k] = He;
+    }
+    //water table of the column
+    double zedge = He - ztope[k];
+
+    //temperatures of the column, recovered from enthalpy if necessary
+    double *Tk = Tin[k];
+    double *lf = NULL;
+    if (stg->enthalpy) {
+        int t = omp_get_thread_num() % nthr;
+        Tk = tcol[t];
+        lf = lcol[t];
+        for (long i=0; i<Nz; i++)
+            Tk[i] = f_enthalpy_temp(poro[i], Tin[k][i], zc[i] < zedge ? 1.0 : 0.0, lf + i);
+        if (diagnose)
+            for (long i=0; i<Nz; i++)
+                temp[k][i] = Tk[i];
+    }
+
+    //find the aquifer bottom and the cell containing it
+    aqbot[k] = f_aquifer_bottom(Tk, Tsurf[k]);
+    long fidx = point_inside(ze, aqbot[k], Nz+1);
+
+    //one pass up the column computes thermal gradients, fluxes, saturation
+    //fractions, thermal capacities, and thermal time derivatives, all in
+    //double precision, then stores the diagnostics at storage precision if
+    //they're wanted
+    double gt, qr, sw, si, cap;
+    //geothermal gradient and flux on the bottom edge
+    gt = -stg->fTgeo/ktherm;
+    double ql = f_qT(gt);
+    if (diagnose) {
+        gradT[k][0] = gt;
+        qT[k][0] = ql;
+    }
     for (long i=0; i<Nz; i++) {
-        if ( zc[i] < zedge ) {
-            if ( i == fidx) {
-                isat[i] = (aqbot - ze[i])/delz[i];
-                wsat[i] = 1.0 - isat[i];
-            } else {
-                if ( Tin[i] < TFREEZE ) {
-                    isat[i] = 1.0;
-                    wsat[i] = 0.0;
-                } else {
-                    isat[i] = 0.0;
-                    wsat[i] = 1.0;
-                }
-            }
+        //gradient on the upper edge of the cell, interior or surface
+        if (i < Nz-1)
+            gt = (Tk[i+1] - Tk[i])/(zc[i+1] - zc[i]);
+        else
+            gt = (Tsurf[k] - Tk[Nz-1])/(delz[Nz-1]/2.0);
+        qr = f_qT(gt);
+        if (stg->enthalpy) {
+            //saturation fractions from the liquid fraction of pore water
+            sw = (zc[i] < zedge) ? lf[i] : 0.0;
+            si = (zc[i] < zedge) ? 1.0 - lf[i] : 0.0;
+            //sensible thermal capacity, for output only
+            cap = f_captherm(poro[i], Tk[i], sw, si);
+            //enthalpy time derivative
+            dTdt[k][i] = (ql - qr)/delz[i];
         } else {
-            isat[i] = 0.0;
-            wsat[i] = 0.0;
+            //saturation fractions and thermal capacity
+            f_sat(i, fidx, zedge, aqbot[k], Tk[i], &sw, &si);
+            cap = f_captherm(poro[i], Tk[i], sw, si);
+            //time derivative
+            dTdt[k][i] = f_dTdt(ql, qr, delz[i], cap);
+        }
+        //store diagnostics
+        if (diagnose) {
+            gradT[k][i+1] = gt;
+            qT[k][i+1] = qr;
+            wsat[k][i] = to_sat(sw);
+            isat[k][i] = to_sat(si);
+            captherm[k][i] = cap;
+            //track the storage error if validating
+            if (stg->precval) {
+                double *e = perr[omp_get_thread_num() % nthr];
+                e[0] = std::max(e[0], fabs(gradT[k][i+1] - gt)/(fabs(gt) + 1e-300));
+                e[1] = std::max(e[1], fabs(qT[k][i+1] - qr)/(fabs(qr) + 1e-300));
+                e[2] = std::max(e[2], fabs(captherm[k][i] - cap)/cap);
+                e[3] = std::max(e[3], fabs(from_sat(wsat[k][i]) - sw));
+                e[4] = std::max(e[4], fabs(from_sat(isat[k][i]) - si));
+            }
+        }
+        //move up
+        ql = qr;
+    }
+
+    //compute hydraulic conductivity for the edge
+    Kint[k] = f_Kint(aqbot[k], zedge, Tk);
+    //compute GW flux for the edge
+    qH[k] = f_qH(gH, Kint[k]);
+}
+
+void BousThermModel::ode_cell (long r, long j) {
+
+    //index of the cell and of the column on its left edge
+    long c = r*Nx + j;
+    long k = r*(Nx+1) + j;
+
+    //porosity at the water table
+    double po = poro[point_inside(ze, Hin[c] - ztopc[c], Nz+1)];
+
+    //horizontal (x) flux divergence
+    dHdt[c] = f_dHdt(qH[k], qH[k+1], po, delx[j]);
+
+    //flux divergence across rows in map-view domains
+    if (Ny > 1) {
+        //cell averaged transmissivities
+        double Kc = (Kint[k] + Kint[k+1])/2.0;
+        double Kl = 0.0, Kh = 0.0;
+        if (r > 0) Kl = (Kint[k-Nx-1] + Kint[k-Nx])/2.0;
+        if (r < Ny-1) Kh = (Kint[k+Nx+1] + Kint[k+Nx+2])/2.0;
+        //flux across the lower row face, zero on the boundary
+        double ql = 0.0, qh = 0.0;
+        if (r > 0) {
+            double gHy = (Hin[c] - Hin[c-Nx])/(yc[r] - yc[r-1]);
+            ql = f_qH(gHy, (Kl + Kc)/2.0);
+            if (diagnose) {
+                gradHy[c] = gHy;
+                qHy[c] = ql;
+            }
         }
+        //flux across the upper row face, identical to the neighbor's lower face
+        if (r < Ny-1)
+            qh = f_qH((Hin[c+Nx] - Hin[c])/(yc[r+1] - yc[r]), (Kc + Kh)/2.0);
+        dHdt[c] += f_dHdt(ql, qh, po, dely[r]);
     }
+
+    //the water table is advanced separately if it's implicit
+    if (stg->implicitH) dHdt[c] = 0.0;
 }
 
 void BousThermModel::ode_fun (double *solin, double *fout) {
 
-    //----------------------------------------------------------
+    //a persistent team evaluates collectively, otherwise start a team
+    if (team) {
+        ode_fun_team(solin, fout);
+    } else {
+        #pragma omp parallel num_threads(nthr)
+        ode_fun_team(solin, fout);
+    }
+}
 
-    //aliases for the inputs
-    Hin = solin;
-    for (long j=0; j<Nx+1; j++)
-        Tin[j] = solin + Nx + Nz*j;
-    //aliases for the outputs
-    dHdt = fout;
-    for (long j=0; j<Nx+1; j++)
-        dTdt[j] = fout + Nx + Nz*j;
+void BousThermModel::ode_fun_team (double *solin, double *fout) {
 
     //----------------------------------------------------------
 
-    //update surface temperature
-    for (long j=0; j<Nx+1; j++)
-        Tsurf[j] = f_surf_temp(get_t(), htope[j], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR);
-
-    //hydraulic gradients and edge values
-    //left edge
-    gradH[0] = 0.0;
-    Hedge[0] = Hin[0];
-    //interior edges
-    for (long j=1; j<Nx; j++) {
-        gradH[j] = (Hin[j] - Hin[j-1])/(xc[j] - xc[j-1]);
-        Hedge[j] = Hin[j-1] + gradH[j]*(xe[j] - xc[j-1]);
-        //check the edge value is below the surface
-        if ( Hedge[j] > ztope[j] )
-            Hedge[j] = ztope[j];
+    //aliases for the inputs and outputs, the column aliases and surface
+    //temperatures are set in ode_column()
+    #pragma omp single
+    {
+        Hin = solin;
+        dHdt = fout;
     }
-    //right edge
-    gradH[Nx] = 0.0;
-    Hedge[Nx] = Hin[Nx-1];
 
-    //big parallel loop computes
+    //----------------------------------------------------------
+
+    //first loop over tiles computes, column by column,
+    //  hydraulic gradients and edge values
     //  thermal gradients
     //  aquifer bottom points
     //  saturation fractions of water and ice
@@ -288,58 +873,1370 @@ void BousThermModel::ode_fun (double *solin, double *fout) {
     //  thermal fluxes
     //  vertically integrated hydraulic conductivities
     //  hydraulic fluxes
-    #pragma omp parallel for
-    for (long j=0; j<Nx+1; j++) {
-        //geothermal gradient
-        gradT[j][0] = -stg->fTgeo/ktherm;
-        //interior edges
-        for (long i=1; i<Nz; i++)
-            gradT[j][i] = (Tin[j][i] - Tin[j][i-1])/(zc[i] - zc[i-1]);
-        //surface gradient
-        gradT[j][Nz] = (Tsurf[j] - Tin[j][Nz-1])/(delz[Nz-1]/2.0);
-        //find the aquifer bottom
-        aqbot[j] = f_aquifer_bottom(Tin[j], Tsurf[j]);
-        //update saturation fractions
-        update_sat(Hedge[j] - ztope[j], aqbot[j], Tin[j], wsat[j], isat[j]);
-        //compute thermal fluxes
-        for (long i=0; i<Nz+1; i++)
-            qT[j][i] = f_qT(gradT[j][i]);
-        //update thermal capacities and compute thermal time derivatives
-        for (long i=0; i<Nz; i++) {
-            captherm[j][i] = f_captherm(poro[i], Tin[j][i], wsat[j][i], isat[j][i]);
-            dTdt[j][i] = f_dTdt(qT[j][i], qT[j][i+1], delz[i], captherm[j][i]);
+    //the water table values read at tile boundaries are the halo, which is
+    //shared memory and read directly
+    //each thread works on its own range of tiles and times every tile, if
+    //the runtime gives a smaller team the threads share the ranges
+    for (int t=omp_get_thread_num(); t<nthr; t+=omp_get_num_threads()) {
+        double tic = omp_get_wtime();
+        for (long n=tb[t]; n<tb[t+1]; n++) {
+            double ticn = omp_get_wtime();
+            for (long r=tiles[n].r0; r<tiles[n].r1; r++)
+                for (long j=tiles[n].j0; j<tiles[n].j1; j++)
+                    ode_column(r, j, get_t());
+            tcost[n] += omp_get_wtime() - ticn;
         }
-        //compute hydraulic conductivity for the edge
-        Kint[j] = f_Kint(aqbot[j], Hedge[j] - ztope[j], Tin[j]);
-        //compute GW flux for the edge
-        qH[j] = f_qH(gradH[j], Kint[j]);
+        tbusy[t] += omp_get_wtime() - tic;
     }
 
     //----------------------------------------------------------
 
-    //compute hydraulic time derivatives
-    for (long j=0; j<Nx; j++)
-        dHdt[j] = f_dHdt(qH[j], qH[j+1], poro[point_inside(ze, Hin[j] - ztopc[j], Nz+1)], delx[j]);
+    //the barrier after the first loop is the halo exchange of hydraulic
+    //fluxes and conductivities, then compute hydraulic time derivatives for
+    //the cells whose left edge is in each tile
+    #pragma omp barrier
+    for (int t=omp_get_thread_num(); t<nthr; t+=omp_get_num_threads()) {
+        double tic = omp_get_wtime();
+        for (long n=tb[t]; n<tb[t+1]; n++)
+            for (long r=tiles[n].r0; r<tiles[n].r1; r++)
+                for (long j=tiles[n].j0; j<std::min(tiles[n].j1, Nx); j++)
+                    ode_cell(r, j);
+        tbusy[t] += omp_get_wtime() - tic;
+    }
+    //all time derivatives are done before anyone uses them
+    #pragma omp barrier
+}
 
+void BousThermModel::update_diagnostics () {
+
+    //evaluate the time derivatives at the current state, storing everything
+    if (team) {
+        #pragma omp single
+        diagnose = true;
+        ode_fun(get_sol(), fdiag);
+        #pragma omp single
+        diagnose = false;
+    } else {
+        diagnose = true;
+        ode_fun(get_sol(), fdiag);
+        diagnose = false;
+    }
 }
 
 void BousThermModel::update_evaporation () {
     //take water out of the top as necessary, as evaporation
-    for (long j=0; j<Nx; j++) {
-        if ( H[j] > ztopc[j] ) {
-            //evaporation rate by area (m^2/s)
-            evap[j] = (H[j] - ztopc[j])*delx[j]*poro_surf/get_dt();
-            //evaporation rate by depth (m/s)
-            evapw[j] = (H[j] - ztopc[j])*poro_surf/get_dt();
-            //contribution to cumulative evaporation array (m^2)
-            cumevap[j] += evap[j]*get_dt();
-            //remove excess water
-            H[j] = ztopc[j];
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<Nx; j++) {
+            long c = r*Nx + j;
+            if ( H[c] > ztopc[c] ) {
+                //evaporation rate by area (m^2/s), or volume (m^3/s) in map view
+                evap[c] = (H[c] - ztopc[c])*delx[j]*dely[r]*poro_surf/get_dt();
+                //evaporation rate by depth (m/s)
+                evapw[c] = (H[c] - ztopc[c])*poro_surf/get_dt();
+                //contribution to cumulative evaporation array
+                cumevap[c] += evap[c]*get_dt();
+                //remove excess water
+                H[c] = ztopc[c];
+            } else {
+                evap[c] = 0.0;
+                evapw[c] = 0.0;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//implicit groundwater flow
+
+double BousThermModel::column_Kint (long r, long j, double *Hc) {
+
+    //index of the column
+    long k = r*(Nx+1) + j;
+    //water table at the column
+    double gH;
+    double zedge = f_Hedge(r, j, Hc, &gH) - ztope[k];
+    //temperatures of the column, recovered from enthalpy if necessary
+    double *Tk = T[k];
+    if (stg->enthalpy) {
+        int t = omp_get_thread_num() % nthr;
+        Tk = tcol[t];
+        for (long i=0; i<Nz; i++)
+            Tk[i] = f_enthalpy_temp(poro[i], T[k][i], zc[i] < zedge ? 1.0 : 0.0, lcol[t] + i);
+    }
+    //integrate the conductivity down to the aquifer bottom
+    return( f_Kint(f_aquifer_bottom(Tk, Tsurf[k]), zedge, Tk) );
+}
+
+void BousThermModel::solve_H_implicit (double dt) {
+
+    //start from the water table at the beginning of the step
+    for (long c=0; c<Ncell; c++)
+        Hold[c] = H[c];
+
+    long iter;
+    for (iter=0; iter<stg->npicard; iter++) {
+
+        //transmissivities of every column from the latest water table
+        #pragma omp parallel num_threads(nthr)
+        for (int t=omp_get_thread_num(); t<nthr; t+=omp_get_num_threads())
+            for (long n=tb[t]; n<tb[t+1]; n++)
+                for (long r=tiles[n].r0; r<tiles[n].r1; r++)
+                    for (long j=tiles[n].j0; j<tiles[n].j1; j++)
+                        Kint[r*(Nx+1) + j] = column_Kint(r, j, H);
+
+        //explicit flow across the row faces, from the starting water table
+        if ( (iter == 0) && (Ny > 1) ) {
+            for (long r=0; r<Ny; r++) {
+                for (long j=0; j<Nx; j++) {
+                    long c = r*Nx + j, k = r*(Nx+1) + j;
+                    double Kc = (Kint[k] + Kint[k+1])/2.0, ql = 0.0, qh = 0.0;
+                    if (r > 0)
+                        ql = f_qH((H[c] - H[c-Nx])/(yc[r] - yc[r-1]), ((Kint[k-Nx-1] + Kint[k-Nx])/2.0 + Kc)/2.0);
+                    if (r < Ny-1)
+                        qh = f_qH((H[c+Nx] - H[c])/(yc[r+1] - yc[r]), (Kc + (Kint[k+Nx+1] + Kint[k+Nx+2])/2.0)/2.0);
+                    hsrc[c] = (ql - qh)/dely[r];
+                }
+            }
+        }
+
+        //backward Euler along each row, with the surface constraint
+        double dmax = 0.0;
+        #pragma omp parallel for num_threads(nthr) schedule(dynamic) reduction(max:dmax)
+        for (long r=0; r<Ny; r++) {
+            //the full system, the system with held cells fixed, the solution, and scratch
+            double *a = tdsys[omp_get_thread_num() % nthr];
+            double *b = a + Nx, *cc = b + Nx, *d = cc + Nx;
+            double *ah = d + Nx, *bh = ah + Nx, *ch = bh + Nx, *dh = ch + Nx;
+            double *x = dh + Nx, *w = x + Nx;
+            double *Hr = H + r*Nx;
+            //row j of the system is po*delx*(H - Hold) = dt*(net inflow - evaporation)
+            for (long j=0; j<Nx; j++) {
+                long c = r*Nx + j, k = r*(Nx+1) + j;
+                double po = poro[point_inside(ze, Hold[c] - ztopc[c], Nz+1)];
+                double gl = (j > 0) ? dt*Kint[k]/(xc[j] - xc[j-1]) : 0.0;
+                double gr = (j < Nx-1) ? dt*Kint[k+1]/(xc[j+1] - xc[j]) : 0.0;
+                a[j] = -gl;
+                b[j] = po*delx[j] + gl + gr;
+                cc[j] = -gr;
+                d[j] = po*delx[j]*Hold[c] + dt*delx[j]*hsrc[c];
+            }
+            //active set iterations, each one holds or releases at least one
+            //cell, so they can't take more than a few passes over the row
+            bool *held = hsurf + r*Nx;
+            for (long m=0; m<2*Nx+2; m++) {
+                //solve with the held cells fixed at the surface
+                for (long j=0; j<Nx; j++) {
+                    if (held[j]) {
+                        ah[j] = 0.0;
+                        bh[j] = 1.0;
+                        ch[j] = 0.0;
+                        dh[j] = ztopc[r*Nx + j];
+                    } else {
+                        ah[j] = a[j];
+                        bh[j] = b[j];
+                        ch[j] = cc[j];
+                        dh[j] = d[j];
+                    }
+                }
+                tridiag(Nx, ah, bh, ch, dh, x, w);
+                //hold cells above the surface and release held cells that
+                //would need negative evaporation
+                bool changed = false;
+                for (long j=0; j<Nx; j++) {
+                    if (!held[j] && (x[j] > ztopc[r*Nx + j])) {
+                        held[j] = true;
+                        changed = true;
+                    } else if (held[j]) {
+                        double e = d[j] - b[j]*x[j];
+                        if (j > 0) e -= a[j]*x[j-1];
+                        if (j < Nx-1) e -= cc[j]*x[j+1];
+                        if (e < 0.0) {
+                            held[j] = false;
+                            changed = true;
+                        }
+                    }
+                }
+                if (!changed) break;
+            }
+            //store the new water table and the evaporation of held cells
+            for (long j=0; j<Nx; j++) {
+                long c = r*Nx + j;
+                dmax = std::max(dmax, fabs(x[j] - Hr[j]));
+                Hr[j] = x[j];
+                if (held[j]) {
+                    //evaporation is the inflow the held cell can't store
+                    double e = d[j] - b[j]*x[j];
+                    if (j > 0) e -= a[j]*x[j-1];
+                    if (j < Nx-1) e -= cc[j]*x[j+1];
+                    evap[c] = e*dely[r]/dt;
+                    evapw[c] = e/(delx[j]*dt);
+                } else {
+                    evap[c] = 0.0;
+                    evapw[c] = 0.0;
+                }
+            }
+        }
+
+        //converged when the water table stops changing
+        if (dmax < stg->tolpicard) break;
+    }
+    //record the iterations
+    if (iter == stg->npicard) npic_fail++;
+    else iter++;
+    npic_max = std::max(npic_max, iter);
+
+    //cumulative evaporation
+    for (long c=0; c<Ncell; c++)
+        cumevap[c] += evap[c]*dt;
+}
+
+//------------------------------------------------------------------------------
+//local time stepping
+
+void BousThermModel::step_local (double dt) {
+
+    //evaluate everything at the beginning of the step, which gives the
+    //capacities for the column limits, the first slope of every column, the
+    //groundwater fluxes, and the flow between rows
+    diagnose = true;
+    ode_fun(get_sol(), ltsout);
+    neval_++;
+    for (long k=0; k<Ncol; k++) qH0[k] = qH[k];
+
+    //freeze the water table for the columns
+    for (long c=0; c<Ncell; c++) ltsin[c] = H[c];
+    Hin = ltsin;
+    dHdt = ltsout;
+
+    //each column advances on its own, the columns are very uneven in cost so
+    //they're handed out dynamically
+    long nsum = 0, nmax = 0;
+    #pragma omp parallel for schedule(dynamic) num_threads(nthr) reduction(+:nsum) reduction(max:nmax)
+    for (long k=0; k<Ncol; k++) {
+        long n = column_substeps(k/(Nx+1), k % (Nx+1), get_t(), dt);
+        nsum += n;
+        nmax = std::max(nmax, n);
+    }
+    diagnose = false;
+    nsub_sum += nsum;
+    nsub_max = std::max(nsub_max, nmax);
+    nsub_all += nmax*Ncol;
+    nsub_steps++;
+
+    //exchange the integrated fluxes, the flow between rows is explicit
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<Nx; j++) {
+            long c = r*Nx + j;
+            long k = r*(Nx+1) + j;
+            double po = poro[point_inside(ze, H[c] - ztopc[c], Nz+1)];
+            double dHy = ltsout[c] - f_dHdt(qH0[k], qH0[k+1], po, delx[j]);
+            H[c] += f_dHdt(qHint[k], qHint[k+1], po, delx[j]) + dt*dHy;
+        }
+    }
+}
+
+long BousThermModel::column_substeps (long r, long j, double t0, double dt) {
+
+    long k = r*(Nx+1) + j;
+    long n = 0;
+    double t = t0, *f1 = ltsf[omp_get_thread_num() % nthr];
+    //the slope, flux, and capacities at the beginning of the step are already
+    //evaluated, stages are evaluated in the column's part of the stage arrays
+    Tin[k] = ltsin + Ncell + Nz*k;
+    dTdt[k] = ltsout + Ncell + Nz*k;
+    qHint[k] = 0.0;
+    bool last = false;
+    while (!last) {
+        //substep from the column's own limit, landing on the end of the step
+        long il;
+        double h = stg->dtsafe*column_dtlim(k, &il);
+        if (h*(1.0 + 1e-3) >= t0 + dt - t) {
+            h = t0 + dt - t;
+            last = true;
+        }
+        //explicit trapezoidal substep
+        double q1 = qH[k];
+        for (long i=0; i<Nz; i++) {
+            f1[i] = dTdt[k][i];
+            Tin[k][i] = T[k][i] + h*f1[i];
+        }
+        ode_column(r, j, t + h);
+        for (long i=0; i<Nz; i++) T[k][i] += h*(f1[i] + dTdt[k][i])/2.0;
+        qHint[k] += h*(q1 + qH[k])/2.0;
+        t += h;
+        n++;
+        //slope at the new state for the next substep
+        if (!last) {
+            for (long i=0; i<Nz; i++) Tin[k][i] = T[k][i];
+            ode_column(r, j, t);
+        }
+    }
+
+    return(n);
+}
+
+//------------------------------------------------------------------------------
+//exponential time differencing
+
+void BousThermModel::column_operator (long k, double *a, double *b, double *c) {
+
+    for (long i=0; i<Nz; i++) {
+        //conductances to the cells below and above, or to the surface
+        //temperature half a cell above the top cell, the bottom has a fixed flux
+        double gl = (i > 0) ? ktherm/(zc[i] - zc[i-1]) : 0.0;
+        double gh = (i < Nz-1) ? ktherm/(zc[i+1] - zc[i]) : ktherm/(delz[i]/2.0);
+        if (stg->enthalpy) {
+            //acting on enthalpy, through the sensible capacity of each cell
+            a[i] = (i > 0) ? gl/(delz[i]*captherm[k][i-1]) : 0.0;
+            b[i] = -(gl + gh)/(delz[i]*captherm[k][i]);
+            c[i] = (i < Nz-1) ? gh/(delz[i]*captherm[k][i+1]) : 0.0;
+        } else {
+            //acting on temperature
+            double s = 1.0/(delz[i]*captherm[k][i]);
+            a[i] = s*gl;
+            b[i] = -s*(gl + gh);
+            c[i] = (i < Nz-1) ? s*gh : 0.0;
+        }
+    }
+}
+
+void BousThermModel::step_exponential (double dt) {
+
+    double *sol = get_sol();
+
+    //time derivatives and capacities at the beginning of the step
+    diagnose = true;
+    ode_fun(sol, etdf0);
+    diagnose = false;
+    neval_++;
+
+    //first stage, the water table is an Euler step
+    #pragma omp parallel for schedule(static) num_threads(nthr)
+    for (long k=0; k<Ncol; k++) {
+        int t = omp_get_thread_num() % nthr;
+        double *a = etdcol[t], *b = a + Nz, *c = b + Nz;
+        double *u = etdu + Ncell + Nz*k;
+        column_operator(k, a, b, c);
+        phi_matvec(Nz, a, b, c, dt, etdf0 + Ncell + Nz*k, 1, u, etdz[t]);
+        for (long i=0; i<Nz; i++) u[i] = T[k][i] + dt*u[i];
+    }
+    for (long c=0; c<Ncell; c++) etdu[c] = H[c] + dt*etdf0[c];
+
+    //time derivatives after the first stage, at the end of the step so the
+    //change of the surface temperature over the step is in the remainder
+    t_ += dt;
+    ode_fun(etdu, etdf1);
+    t_ -= dt;
+    neval_++;
+
+    //second stage corrects with the change of the remainder, N(u1) - N(u) =
+    //f(u1) - f(u) - A*(u1 - u)
+    #pragma omp parallel for schedule(static) num_threads(nthr)
+    for (long k=0; k<Ncol; k++) {
+        int t = omp_get_thread_num() % nthr;
+        double *a = etdcol[t], *b = a + Nz, *c = b + Nz, *d = c + Nz, *e = d + Nz;
+        double *u = etdu + Ncell + Nz*k;
+        double *f0 = etdf0 + Ncell + Nz*k, *f1 = etdf1 + Ncell + Nz*k;
+        column_operator(k, a, b, c);
+        for (long i=0; i<Nz; i++) {
+            double Ad = b[i]*(u[i] - T[k][i]);
+            if (i > 0) Ad += a[i]*(u[i-1] - T[k][i-1]);
+            if (i < Nz-1) Ad += c[i]*(u[i+1] - T[k][i+1]);
+            d[i] = f1[i] - f0[i] - Ad;
+        }
+        phi_matvec(Nz, a, b, c, dt, d, 2, e, etdz[t]);
+        for (long i=0; i<Nz; i++) T[k][i] = u[i] + dt*e[i];
+    }
+    for (long c=0; c<Ncell; c++) H[c] += dt*(etdf0[c] + etdf1[c])/2.0;
+}
+
+//------------------------------------------------------------------------------
+//stable time step
+
+double BousThermModel::stable_dt () {
+
+    //heat conduction in every cell of every column
+    dtlim_T = INFINITY;
+    for (long k=0; k<Ncol; k++) {
+        long i;
+        double d = column_dtlim(k, &i);
+        if (d < dtlim_T) {
+            dtlim_T = d;
+            klim_T = k;
+            ilim_T = i;
+        }
+    }
+
+    //groundwater flow in every hydraulic cell
+    dtlim_H = INFINITY;
+    for (long r=0; r<Ny; r++) {
+        for (long j=0; j<Nx; j++) {
+            long c = r*Nx + j;
+            long k = r*(Nx+1) + j;
+            //porosity at the water table
+            double po = poro[point_inside(ze, H[c] - ztopc[c], Nz+1)];
+            //conductances through the x edges, closed at the ends of rows,
+            //unless the water table is implicit along x
+            double d = 0.0;
+            if (!stg->implicitH) {
+                if (j > 0) d += 2.0*Kint[k]/(xc[j] - xc[j-1]);
+                if (j < Nx-1) d += 2.0*Kint[k+1]/(xc[j+1] - xc[j]);
+                d /= po*delx[j];
+            }
+            //conductances through the row faces, with the face transmissivity
+            //used by ode_cell()
+            if (Ny > 1) {
+                double Kc = (Kint[k] + Kint[k+1])/2.0, dy = 0.0;
+                if (r > 0) dy += ((Kint[k-Nx-1] + Kint[k-Nx])/2.0 + Kc)/2.0/(yc[r] - yc[r-1]);
+                if (r < Ny-1) dy += ((Kint[k+Nx+1] + Kint[k+Nx+2])/2.0 + Kc)/2.0/(yc[r+1] - yc[r]);
+                d += 2.0*dy/(po*dely[r]);
+            }
+            if ( (d > 0.0) && (2.0/d < dtlim_H) ) {
+                dtlim_H = 2.0/d;
+                clim_H = c;
+            }
+        }
+    }
+
+    return( std::min(dtlim_T, dtlim_H) );
+}
+
+double BousThermModel::column_dtlim (long k, long *ilim) {
+
+    double dtlim = INFINITY;
+    *ilim = -1;
+    for (long i=0; i<Nz; i++) {
+        //conductances to neighboring cells count twice in the Gershgorin
+        //bound, once on the diagonal and once off it, but the surface
+        //temperature half a cell above the top cell is fixed and the
+        //lower edge has a fixed flux
+        double g = 0.0;
+        if (i > 0) g += 2.0/(zc[i] - zc[i-1]);
+        if (i < Nz-1) g += 2.0/(zc[i+1] - zc[i]);
+        else g += 2.0/delz[i];
+        //bound on the eigenvalues of the cell
+        double d = ktherm*g/(delz[i]*captherm[k][i]);
+        if (2.0/d < dtlim) {
+            dtlim = 2.0/d;
+            *ilim = i;
+        }
+    }
+
+    return(dtlim);
+}
+
+void BousThermModel::print_stable_dt () {
+
+    //thermal limit and its column
+    long r = klim_T/(Nx+1), j = klim_T % (Nx+1);
+    printf("      thermal step limit ......... %g sec", dtlim_T);
+    if (Ny > 1) printf(" (row %li, column %li, z = %g m)", r, j, zc[ilim_T]);
+    else printf(" (column %li, x = %g m, z = %g m)", j, xe[j], zc[ilim_T]);
+    printf("%s\n", dtlim_T <= dtlim_H ? ", binding" : "");
+    //groundwater limit and its cell
+    if ( (clim_H < 0) && stg->implicitH ) {
+        printf("      groundwater step limit ..... none (implicit water table)\n");
+    } else if (clim_H < 0) {
+        printf("      groundwater step limit ..... none (no flow)\n");
+    } else {
+        r = clim_H/Nx;
+        j = clim_H % Nx;
+        printf("      groundwater step limit ..... %g sec", dtlim_H);
+        //only flow across the row faces is explicit with an implicit water table
+        if ( (Ny > 1) && stg->implicitH ) printf(" (row faces, row %li, cell %li)", r, j);
+        else if (Ny > 1) printf(" (row %li, cell %li)", r, j);
+        else printf(" (cell %li, x = %g m)", j, xc[j]);
+        printf("%s\n", dtlim_H < dtlim_T ? ", binding" : "");
+    }
+    //warn about steps that are probably unstable, the columns substep on
+    //their own with local time stepping and are integrated exactly with
+    //exponential time differencing
+    if ( (integrator == TRAPZ) && (get_dt() > std::min(dtlim_T, dtlim_H)) )
+        printf("      WARNING: the time step (%g sec) exceeds the stability limit\n", get_dt());
+    if ( ( (integrator == LTS) || (integrator == ETD) ) && (get_dt() > dtlim_H) )
+        printf("      WARNING: the time step (%g sec) exceeds the groundwater stability limit\n", get_dt());
+}
+
+void BousThermModel::solve_loop (double tint, double dtmax, int nsnap, const char *dirout, bool autodt, bool persist) {
+
+    dt_ = dtmax;
+    before_solve();
+
+    //snap times are evenly spaced from time zero, the last one at the end of
+    //the solve, so a solve continuing from a warm start or the coarse grid
+    //writes the snaps after its starting time under the numbers a solve from
+    //zero gives them, a snap at the starting time written right away
+    double t0 = get_t(), tend = t0 + tint, tsnap = tend;
+    long isnap = 0;
+    while ( (isnap < nsnap) && (tsnap*double(isnap + 1)/double(nsnap) < t0 - 1e-3*dtmax) ) isnap++;
+    if ( (isnap < nsnap) && (tsnap*double(isnap + 1)/double(nsnap) <= t0 + 1e-3*dtmax) ) {
+        snap(dirout, isnap, t0);
+        isnap++;
+    }
+    double tnext = (isnap < nsnap) ? tsnap*double(isnap + 1)/double(nsnap) : tend;
+
+    //variables shared by the team, changed by one thread at a time
+    double dt = dtmax, h = dtmax;
+    unsigned long n = 0;
+    bool done = false, estimate = false, land = false;
+    //the end is reached within a thousandth of a step
+    tend -= 1e-3*dtmax;
+
+    //with a persistent team, every thread runs the time loop, sharing the
+    //ode function evaluations and vector updates of each step while one
+    //thread does the bookkeeping, otherwise a single thread runs the loop
+    //and each evaluation of the ode function starts its own team
+    #pragma omp parallel if(persist) num_threads(nthr)
+    {
+        #pragma omp single
+        team = persist;
+
+        while (true) {
+            #pragma omp single
+            {
+                done = !(get_t() < tend);
+                estimate = autodt && (n % stg->ndt == 0);
+            }
+            if (done) break;
+            //estimate the stability limit periodically
+            if (estimate) {
+                update_diagnostics();
+                //only groundwater flow limits local time stepping and exponential
+                //time differencing
+                #pragma omp single
+                {
+                    dt = stable_dt();
+                    if ( (integrator == LTS) || (integrator == ETD) ) dt = dtlim_H;
+                    dt = std::min(dtmax, stg->dtsafe*dt);
+                }
+            }
+            //shorten the step to land on the next snap, a step that lands
+            //within a thousandth of a step of it is left alone
+            #pragma omp single
+            {
+                land = ( dt*(1.0 + 1e-3) >= tnext - get_t() );
+                h = ( land && (dt*(1.0 - 1e-3) > tnext - get_t()) ) ? tnext - get_t() : dt;
+                dt_ = h;
+            }
+            //take the step
+            advance(h);
+            //bookkeeping and snapping on one thread, snaps evaluate their
+            //diagnostics without the team
+            #pragma omp single
+            {
+                t_ += h;
+                nstep_++;
+                team = false;
+                after_step(get_t());
+                n++;
+                if (land) {
+                    if (isnap < nsnap) snap(dirout, isnap, get_t());
+                    isnap++;
+                    tnext = (isnap < nsnap) ? tsnap*double(isnap + 1)/double(nsnap) : tend;
+                }
+                team = persist;
+            }
+        }
+
+        #pragma omp single
+        team = false;
+    }
+    dt_ = dt;
+
+    after_solve();
+}
+
+//------------------------------------------------------------------------------
+//propagation
+
+void BousThermModel::propagate (double *u0, double t0, double t1, long nstep, double *u1) {
+
+    //start from the given state with a clean record
+    set_sol(u0);
+    set_t(t0);
+    if (stg->enthalpy) count_wet();
+    o_t.clear();
+    o_evap.clear();
+    o_evapw.clear();
+    o_maxaqbot.clear();
+    o_minaqbot.clear();
+    for (long c=0; c<Ncell; c++) {
+        evap[c] = 0.0;
+        evapw[c] = 0.0;
+        cumevap[c] = 0.0;
+    }
+    reset_stats();
+
+    //fixed steps, with the usual updates after each one, inside a team of one
+    //so the orphaned worksharing of the integrators binds to it even if this
+    //is called from a parallel region, and the ode function's teams nest
+    double h = (t1 - t0)/double(nstep);
+    dt_ = h;
+    #pragma omp parallel num_threads(1)
+    for (long n=0; n<nstep; n++) {
+        step(h);
+        after_step(get_t());
+    }
+    set_t(t1);
+
+    //copy out the final state
+    double *sol = get_sol();
+    for (unsigned long i=0; i<get_neq(); i++) u1[i] = sol[i];
+}
+
+//------------------------------------------------------------------------------
+//spin-up states
+
+//writes a vector with its length
+static void write_vec (FILE *f, std::vector<double> &v) {
+    unsigned long n = v.size();
+    fwrite(&n, sizeof(n), 1, f);
+    if (n > 0) fwrite(v.data(), sizeof(double), n, f);
+}
+
+static bool read_vec (FILE *f, std::vector<double> &v) {
+    unsigned long n;
+    if (fread(&n, sizeof(n), 1, f) != 1) return(false);
+    v.resize(n);
+    return( (n == 0) || (fread(v.data(), sizeof(double), n, f) == n) );
+}
+
+void BousThermModel::save_state (const std::string &fn) {
+
+    std::string tmp = fn + ".tmp." + std::to_string(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) {
+        printf("WARNING: cannot write spin-up state %s\n", fn.c_str());
+        return;
+    }
+    //sizes, for checking on reading
+    unsigned long sizes[2] = {get_neq(), (unsigned long)Ncell};
+    fwrite(sizes, sizeof(unsigned long), 2, f);
+    //time, steps, and the solution
+    double t = get_t();
+    unsigned long long n = get_nstep();
+    fwrite(&t, sizeof(double), 1, f);
+    fwrite(&n, sizeof(n), 1, f);
+    fwrite(get_sol(), sizeof(double), get_neq(), f);
+    //trackers and output vectors
+    fwrite(evap, sizeof(double), Ncell, f);
+    fwrite(evapw, sizeof(double), Ncell, f);
+    fwrite(cumevap, sizeof(double), Ncell, f);
+    write_vec(f, o_t);
+    write_vec(f, o_evap);
+    write_vec(f, o_evapw);
+    write_vec(f, o_maxaqbot);
+    write_vec(f, o_minaqbot);
+    fclose(f);
+    rename(tmp.c_str(), fn.c_str());
+}
+
+void BousThermModel::set_nstep (unsigned long long n) {
+    nstep_ = n;
+}
+
+void BousThermModel::load_state (const std::string &fn) {
+
+    FILE *f = fopen(fn.c_str(), "rb");
+    if (f == NULL) {
+        std::cout << "FAILURE: cannot open state file " << fn << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    unsigned long sizes[2];
+    double t;
+    unsigned long long n;
+    bool ok = (fread(sizes, sizeof(unsigned long), 2, f) == 2)
+           && (sizes[0] == get_neq()) && (sizes[1] == (unsigned long)Ncell)
+           && (fread(&t, sizeof(double), 1, f) == 1)
+           && (fread(&n, sizeof(n), 1, f) == 1)
+           && (fread(get_sol(), sizeof(double), get_neq(), f) == get_neq())
+           && (fread(evap, sizeof(double), Ncell, f) == (size_t)Ncell)
+           && (fread(evapw, sizeof(double), Ncell, f) == (size_t)Ncell)
+           && (fread(cumevap, sizeof(double), Ncell, f) == (size_t)Ncell)
+           && read_vec(f, o_t) && read_vec(f, o_evap) && read_vec(f, o_evapw)
+           && read_vec(f, o_maxaqbot) && read_vec(f, o_minaqbot);
+    fclose(f);
+    if (!ok) {
+        std::cout << "FAILURE: state file " << fn << " is incomplete or doesn't match the grid" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    set_t(t);
+    nstep_ = n;
+    resumed = true;
+    if (stg->enthalpy) count_wet();
+}
+
+//------------------------------------------------------------------------------
+//grid sequencing
+
+//pore space per unit area from the surface down to a depth, with the surface
+//porosity above the surface and the bottom porosity below the grid
+static double pore_depth (double *ze, double *poro, long Nz, double poro_surf, double d) {
+    if (d <= 0.0) return(poro_surf*d);
+    double s = 0.0;
+    for (long i=Nz-1; i>=0; i--) {
+        //cell i spans depths -ze[i+1] to -ze[i]
+        if (d <= -ze[i]) return( s + poro[i]*(d + ze[i+1]) );
+        s += poro[i]*(ze[i+1] - ze[i]);
+    }
+    return( s + poro[0]*(d + ze[0]) );
+}
+
+//heat of a cell from the column variable, enthalpy itself or, for the
+//temperature formulation, the integral of the capacity with the latent heat
+//spread over the AHCW range around the freezing point, so it can be inverted
+static double cell_heat (bool enthalpy, double po, double v, double sat) {
+    if (enthalpy) return(v);
+    double capr = (1.0 - po)*RHO_R*C_R, L = po*sat*RHO_W*LF_W, x = v - TFREEZE;
+    double lat = L*std::min(1.0, std::max(0.0, (x + AHCW/2.0)/AHCW));
+    if (x <= 0.0) return( (capr + po*sat*RHO_W*C_I)*x + lat );
+    return( (capr + po*sat*RHO_W*C_W)*x + lat );
+}
+
+//column variable of a cell from its heat, the inverse of cell_heat()
+static double cell_value (bool enthalpy, double po, double h, double sat) {
+    if (enthalpy) return(h);
+    double capr = (1.0 - po)*RHO_R*C_R, L = po*sat*RHO_W*LF_W;
+    double ci = capr + po*sat*RHO_W*C_I, cw = capr + po*sat*RHO_W*C_W;
+    if (h <= -ci*AHCW/2.0) return( TFREEZE + h/ci );
+    if (h <= L/2.0) return( TFREEZE + (h - L/2.0)/(ci + L/AHCW) );
+    if (h <= cw*AHCW/2.0 + L) return( TFREEZE + (h - L/2.0)/(cw + L/AHCW) );
+    return( TFREEZE + (h - L)/cw );
+}
+
+//minmod of two slopes
+static double minmod (double a, double b) {
+    if (a*b <= 0.0) return(0.0);
+    return( fabs(a) < fabs(b) ? a : b );
+}
+
+void BousThermModel::prolong (BousThermModel *C) {
+
+    long Nxc = C->Nx, Nzc = C->Nz;
+    //coarse cell holding each fine cell, edge, and vertical cell, and the fine
+    //edge at each coarse edge
+    std::vector<long> pc(Nx), pe(Nx+1), pz(Nz), jc(Nxc+1);
+    for (long j=0; j<Nx; j++) pc[j] = point_inside(C->xe, xc[j], Nxc+1);
+    for (long j=0; j<=Nx; j++) {
+        pe[j] = std::min(point_inside(C->xe, xe[j], Nxc+1), Nxc-1);
+        if (xe[j] == C->xe[pe[j]]) jc[pe[j]] = j;
+        if (xe[j] == C->xe[pe[j]+1]) jc[pe[j]+1] = j;
+    }
+    for (long i=0; i<Nz; i++) pz[i] = point_inside(C->ze, zc[i], Nzc+1);
+
+    //initial state, which the columns between the coarse columns start from
+    std::vector<double> T0(Ncol*Nz);
+    for (long k=0; k<Ncol; k++)
+        for (long i=0; i<Nz; i++)
+            T0[k*Nz + i] = T[k][i];
+
+    //--------------------------------------------------------------------------
+    //water table
+
+    //in each coarse cell, the fine water tables keep the depth of the coarse
+    //one below the surface, shifted by the same amount in all of them so the
+    //empty pore space above the water table is the same; that is the water
+    //the ground can still take up, so saturated cells stay saturated, and the
+    //pore water is the same as long as the coarse porosity is the mean of the
+    //fine porosity, as sequence_grid() sets it
+    double wtot = 0.0, wtotc = 0.0;
+    double P = pore_depth(ze, poro, Nz, poro_surf, -ze[0]);
+    double Pc = pore_depth(C->ze, C->poro, Nzc, C->poro_surf, -C->ze[0]);
+    for (long r=0; r<Ny; r++) {
+        long j0 = 0;
+        for (long J=0; J<Nxc; J++) {
+            long cc = r*Nxc + J;
+            //fine cells in the coarse cell
+            long j1 = j0;
+            while ( (j1 < Nx) && (pc[j1] == J) ) j1++;
+            //empty pore space of the coarse cell above the water table
+            double dC = C->ztopc[cc] - C->H[cc];
+            double V = C->delx[J]*pore_depth(C->ze, C->poro, Nzc, C->poro_surf, dC);
+            //bisect for the shift of the fine water table leaving the same
+            //space, until the bracket can't be split
+            double lo = 4.0*ze[0], hi = -4.0*ze[0];
+            for (long j=j0; j<j1; j++) {
+                lo -= fabs(ztopc[r*Nx + j] - C->ztopc[cc]);
+                hi += fabs(ztopc[r*Nx + j] - C->ztopc[cc]);
+            }
+            double sh = (lo + hi)/2.0;
+            while ( (sh > lo) && (sh < hi) ) {
+                double Vf = 0.0;
+                for (long j=j0; j<j1; j++)
+                    Vf += delx[j]*pore_depth(ze, poro, Nz, poro_surf, dC - sh);
+                if (Vf > V) lo = sh;
+                else hi = sh;
+                sh = (lo + hi)/2.0;
+            }
+            //pore water of both grids
+            for (long j=j0; j<j1; j++) {
+                long c = r*Nx + j;
+                H[c] = ztopc[c] - dC + sh;
+                wtot += dely[r]*delx[j]*(P - pore_depth(ze, poro, Nz, poro_surf, ztopc[c] - H[c]));
+            }
+            wtotc += C->dely[r]*(C->delx[J]*Pc - V);
+            j0 = j1;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    //heat
+
+    //heat moves in the columns' own variable, temperature or enthalpy; each
+    //coarse column is reconstructed linearly in its cells, with minmod slopes
+    //so no new extremes appear, then the fine cells of each coarse cell are
+    //shifted by the same heat per volume so their heat matches the coarse
+    //cell's, each with its own water table; the columns don't exchange heat,
+    //so the columns between them keep their own initial profiles plus the
+    //change interpolated in x from their neighbors
+    std::vector<double> Tc(Nzc), v(Nz), hc(Nzc), hf(Nzc), dzc(Nzc, 0.0);
+    for (long i=0; i<Nz; i++) dzc[pz[i]] += delz[i];
+    std::vector< std::vector<double> > dT(Nxc+1, std::vector<double>(Nz));
+    double htot = 0.0, htotc = 0.0;
+    for (long r=0; r<Ny; r++) {
+        for (long J=0; J<=Nxc; J++) {
+            long K = r*(Nxc+1) + J, k = r*(Nx+1) + jc[J];
+            for (long I=0; I<Nzc; I++) Tc[I] = C->T[K][I];
+            //reconstruction
+            for (long i=0; i<Nz; i++) {
+                long I = pz[i];
+                double sl = 0.0;
+                if ( (I > 0) && (I < Nzc-1) )
+                    sl = minmod( (Tc[I+1] - Tc[I])/(C->zc[I+1] - C->zc[I]),
+                                 (Tc[I] - Tc[I-1])/(C->zc[I] - C->zc[I-1]) );
+                v[i] = Tc[I] + sl*(zc[i] - C->zc[I]);
+            }
+            //heat of the coarse cells
+            double gH;
+            double zedc = C->f_Hedge(r, J, C->H, &gH) - C->ztope[K];
+            double zedf = f_Hedge(r, jc[J], H, &gH) - ztope[k];
+            for (long I=0; I<Nzc; I++) {
+                hc[I] = C->delz[I]*cell_heat(stg->enthalpy, C->poro[I], Tc[I], C->zc[I] < zedc ? 1.0 : 0.0);
+                htotc += C->dely[r]*hc[I];
+            }
+            //correction, repeated because the heat of the temperature
+            //formulation is piecewise linear
+            for (int it=0; it<8; it++) {
+                for (long I=0; I<Nzc; I++) hf[I] = 0.0;
+                for (long i=0; i<Nz; i++)
+                    hf[pz[i]] += delz[i]*cell_heat(stg->enthalpy, poro[i], v[i], zc[i] < zedf ? 1.0 : 0.0);
+                bool done = true;
+                for (long I=0; I<Nzc; I++)
+                    if (fabs(hc[I] - hf[I]) > 1e-13*fabs(hc[I])) done = false;
+                if (done) break;
+                for (long i=0; i<Nz; i++) {
+                    double sat = zc[i] < zedf ? 1.0 : 0.0;
+                    double h = cell_heat(stg->enthalpy, poro[i], v[i], sat) + (hc[pz[i]] - hf[pz[i]])/dzc[pz[i]];
+                    v[i] = cell_value(stg->enthalpy, poro[i], h, sat);
+                }
+            }
+            for (long i=0; i<Nz; i++) {
+                dT[J][i] = v[i] - T0[k*Nz + i];
+                htot += dely[r]*delz[i]*cell_heat(stg->enthalpy, poro[i], v[i], zc[i] < zedf ? 1.0 : 0.0);
+            }
+        }
+        //changes interpolated between the coarse columns
+        for (long j=0; j<=Nx; j++) {
+            long k = r*(Nx+1) + j, J = pe[j];
+            double w = (xe[j] - C->xe[J])/(C->xe[J+1] - C->xe[J]);
+            for (long i=0; i<Nz; i++)
+                T[k][i] = T0[k*Nz + i] + (1.0 - w)*dT[J][i] + w*dT[J+1][i];
+        }
+    }
+
+    double dw = fabs(wtot - wtotc)/std::max(fabs(wtotc), 1e-300);
+    double dh = fabs(htot - htotc)/std::max(fabs(htotc), 1e-300);
+    printf("  prolongated from %li x %li to %li x %li cells\n", Nxc, Nzc, Nx, Nz);
+    printf("    pore water .............. %.10e -> %.10e (%.1e relative change)\n", wtotc, wtot, dw);
+    printf("    heat of the columns ..... %.10e -> %.10e (%.1e relative change)\n", htotc, htot, dh);
+    if (dw > 1e-8) printf("WARNING: prolongation changed the pore water by %.1e of itself\n", dw);
+    if (dh > 1e-8) printf("WARNING: prolongation changed the heat of the columns by %.1e of itself\n", dh);
+}
+
+//------------------------------------------------------------------------------
+//forward sensitivity
+
+void BousThermModel::init_sensitivity (std::string &griddir) {
+
+    //the tangent linear step is the trapezoidal method's
+    if ( (integrator != TRAPZ) || stg->implicitH ) {
+        std::cout << "FAILURE: sensitivities require the trapz integrator with an explicit water table" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    unsigned long neq = get_neq();
+    std::string list = stg->sensitivity;
+    size_t i0 = 0, i1;
+    while (i0 < list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        std::string name = list.substr(i0, i1 - i0);
+        i0 = i1 + 1;
+        //ignore spaces around names
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name.length() == 0) continue;
+        //perturbed settings
+        Settings *ps = new Settings(*stg);
+        double *v = physical_param(*ps, name);
+        if (v == NULL) {
+            std::cout << "FAILURE: no physical parameter named " << name << " for sensitivities" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        double dp = stg->sensrel*(*v != 0.0 ? fabs(*v) : 1.0);
+        *v += dp;
+        //perturbed model, starting the derivative from its initial state
+        BousThermModel *pm = new_model(griddir, ps, dirout.c_str());
+        double *s = new double[neq], *u = get_sol(), *up = pm->get_sol();
+        for (unsigned long i=0; i<neq; i++) s[i] = (up[i] - u[i])/dp;
+        sname.push_back(name);
+        sdp.push_back(dp);
+        sstg.push_back(ps);
+        smod.push_back(pm);
+        ssol.push_back(s);
+        o_devap.push_back(std::vector<double>());
+        o_dmaxaqbot.push_back(std::vector<double>());
+        o_dminaqbot.push_back(std::vector<double>());
+        printf("  sensitivity to %s, perturbed by %g\n", name.c_str(), dp);
+    }
+
+    //the first step starts here
+    sprev = new double[neq];
+    sscr = new double[6*neq];
+    double *u = get_sol();
+    for (unsigned long i=0; i<neq; i++) sprev[i] = u[i];
+    tprev = get_t();
+}
+
+void BousThermModel::step_sensitivity () {
+
+    unsigned long neq = get_neq();
+    double dt = get_t() - tprev, *u = get_sol();
+    double *k1 = sscr, *k2 = sscr + neq, *us = sscr + 2*neq,
+           *g1 = sscr + 3*neq, *g2 = sscr + 4*neq, *up = sscr + 5*neq;
+
+    //the stages of the step just taken, both evaluated at its starting time
+    double t1 = get_t();
+    set_t(tprev);
+    ode_fun(sprev, k1);
+    for (unsigned long i=0; i<neq; i++) us[i] = sprev[i] + dt*k1[i];
+    ode_fun(us, k2);
+    set_t(t1);
+    double amax = max(aqbot, Ncol), amin = min(aqbot, Ncol);
+
+    //differencing the ode function rather than whole steps keeps the small
+    //changes of the slopes, which would be lost to rounding in the water table
+    //of a perturbed step
+    for (unsigned p=0; p<smod.size(); p++) {
+        BousThermModel *pm = smod[p];
+        double dp = sdp[p], *s = ssol[p];
+        pm->set_t(tprev);
+        //derivative of the slope at the beginning of the step
+        for (unsigned long i=0; i<neq; i++) up[i] = sprev[i] + dp*s[i];
+        pm->ode_fun(up, g1);
+        for (unsigned long i=0; i<neq; i++) g1[i] = (g1[i] - k1[i])/dp;
+        //derivative of the slope at the predicted state
+        for (unsigned long i=0; i<neq; i++) up[i] = us[i] + dp*(s[i] + dt*g1[i]);
+        pm->ode_fun(up, g2);
+        for (unsigned long i=0; i<neq; i++) g2[i] = (g2[i] - k2[i])/dp;
+        //derivative of the solution at the end of the step
+        for (unsigned long i=0; i<neq; i++) s[i] += dt*(g1[i] + g2[i])/2.0;
+        //cells at the surface lose their excess water as evaporation, so the
+        //derivative of their water table goes into evaporation instead
+        double de = 0.0;
+        for (long r=0; r<Ny; r++) {
+            for (long j=0; j<Nx; j++) {
+                long c = r*Nx + j;
+                if (evap[c] > 0.0) {
+                    de += s[c]*delx[j]*dely[r]*poro_surf/dt;
+                    s[c] = 0.0;
+                }
+            }
+        }
+        if (stg->Rmax) for (long c=0; c<Ncell; c++) s[c] = 0.0;
+        o_devap[p].push_back(de);
+        o_dmaxaqbot[p].push_back( (max(pm->aqbot, Ncol) - amax)/dp );
+        o_dminaqbot[p].push_back( (min(pm->aqbot, Ncol) - amin)/dp );
+    }
+
+    //the next step starts here
+    for (unsigned long i=0; i<neq; i++) sprev[i] = u[i];
+    tprev = t1;
+}
+
+//------------------------------------------------------------------------------
+//in-situ statistics
+
+void BousThermModel::reset_stats () {
+
+    stat_t0 = get_t();
+    if (!stg->stats) return;
+    for (long c=0; c<Ncell; c++) stat_evap[c] = 0.0;
+    for (long k=0; k<Ncol; k++) {
+        stat_minaqbot[k] = INFINITY;
+        stat_maxaqbot[k] = -INFINITY;
+        stat_thaw[k] = -1.0;
+        stat_qH[k] = 0.0;
+    }
+    for (long i=0; i<Ncell*stg->statbins; i++) stat_Hdep[i] = 0.0;
+}
+
+void BousThermModel::update_stats (double dt) {
+
+    double t = get_t();
+    for (long c=0; c<Ncell; c++) {
+        stat_evap[c] += evap[c]*dt;
+        //bin of the water table depth, the last one holding everything deeper
+        long b = long(stg->statbins*(ztopc[c] - H[c])/stg->statdmax);
+        b = std::min(std::max(b, 0L), stg->statbins - 1);
+        stat_Hdep[c*stg->statbins + b] += dt;
+    }
+    for (long k=0; k<Ncol; k++) {
+        stat_minaqbot[k] = std::min(stat_minaqbot[k], aqbot[k]);
+        stat_maxaqbot[k] = std::max(stat_maxaqbot[k], aqbot[k]);
+        if ( (stat_thaw[k] < 0.0) && (aqbot[k] < 0.0) ) stat_thaw[k] = t;
+        stat_qH[k] += qH[k]*dt;
+    }
+}
+
+void BousThermModel::write_stats () {
+
+    //span of the statistics
+    double t1 = get_t(), span = t1 - stat_t0;
+    double tt[2] = {stat_t0, t1};
+    write_double(dirout + '/' + "stat_t", tt, 2);
+    //integrals and extremes
+    write_double(dirout + '/' + "stat_evap", stat_evap, Ncell);
+    write_double(dirout + '/' + "stat_minaqbot", stat_minaqbot, Ncol);
+    write_double(dirout + '/' + "stat_maxaqbot", stat_maxaqbot, Ncol);
+    write_double(dirout + '/' + "stat_thaw", stat_thaw, Ncol);
+    //means over the span, in place since nothing follows
+    for (long k=0; k<Ncol; k++) stat_qH[k] /= span;
+    write_double(dirout + '/' + "stat_qH", stat_qH, Ncol);
+    for (long i=0; i<Ncell*stg->statbins; i++) stat_Hdep[i] /= span;
+    write_double(dirout + '/' + "stat_Hdep", stat_Hdep, Ncell*stg->statbins);
+    //edges of the depth bins
+    std::vector<double> edges(stg->statbins + 1);
+    for (long b=0; b<=stg->statbins; b++) edges[b] = stg->statdmax*double(b)/double(stg->statbins);
+    write_double_vec(dirout + '/' + "stat_Hdepbins", edges);
+}
+
+//------------------------------------------------------------------------------
+//probes
+
+//number of doubles buffered before the probe records are appended to the stream
+#define PROBE_BUFFER 65536
+
+void BousThermModel::init_probes () {
+
+    std::string list = stg->probes;
+    size_t i0 = 0, i1;
+    while (i0 < list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        std::string name = list.substr(i0, i1 - i0);
+        i0 = i1 + 1;
+        //ignore spaces around locations
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name.length() == 0) continue;
+        //x:depth on a transect, x:y:depth on a map-view grid
+        double x, y = 0.0, d;
+        char end;
+        bool ok;
+        if (Ny > 1) ok = (sscanf(name.c_str(), "%lf:%lf:%lf%c", &x, &y, &d, &end) == 3);
+        else ok = (sscanf(name.c_str(), "%lf:%lf%c", &x, &d, &end) == 2);
+        if (!ok) {
+            std::cout << "FAILURE: probes are written " << (Ny > 1 ? "x:y:depth" : "x:depth") << ", not " << name << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if ( (x < xe[0]) || (x > xe[Nx]) || (d < 0.0) || (-d < zdepth)
+                || ( (Ny > 1) && ((y < ye[0]) || (y > ye[Ny])) ) ) {
+            std::cout << "FAILURE: probe " << name << " is outside the grid" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        long r = (Ny > 1) ? point_inside(ye, y, Ny+1) : 0;
+        long j = point_inside(xe, x, Nx+1);
+        long je = (x - xe[j] <= xe[j+1] - x) ? j : j + 1;
+        pname.push_back(name);
+        pcol.push_back(r*(Nx+1) + je);
+        pcell.push_back(r*Nx + j);
+        player.push_back(point_inside(ze, -d, Nz+1));
+    }
+    if ( !pname.empty() && (stg->probeevery < 1) ) {
+        std::cout << "FAILURE: probeevery must be at least 1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!pname.empty()) printf("%lu probes record every %li steps\n", pname.size(), stg->probeevery);
+}
+
+void BousThermModel::record_probes () {
+
+    pbuf.push_back( get_t() );
+    for (unsigned p=0; p<pname.size(); p++) {
+        long k = pcol[p], c = pcell[p], i = player[p];
+        //temperature, recovered from enthalpy if necessary
+        double Tp = T[k][i];
+        if (stg->enthalpy) {
+            double gH, lf;
+            double zedge = f_Hedge(k/(Nx+1), k%(Nx+1), H, &gH) - ztope[k];
+            Tp = f_enthalpy_temp(poro[i], T[k][i], zc[i] < zedge ? 1.0 : 0.0, &lf);
+        }
+        pbuf.push_back(Tp);
+        pbuf.push_back(H[c]);
+        pbuf.push_back(qH[k]);
+        pbuf.push_back(Kint[k]);
+        pbuf.push_back(aqbot[k]);
+        pbuf.push_back(evap[c]);
+    }
+    if (pbuf.size() >= PROBE_BUFFER) flush_probes();
+}
+
+void BousThermModel::flush_probes () {
+
+    if (pbuf.empty()) return;
+    std::string fn = dirout + '/' + "probes";
+    FILE *f = fopen(fn.c_str(), "ab");
+    if (f == NULL) {
+        std::cout << "FAILURE: cannot open file " << fn << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fwrite(pbuf.data(), sizeof(double), pbuf.size(), f);
+    fclose(f);
+    pbuf.clear();
+}
+
+//------------------------------------------------------------------------------
+//events
+
+enum EventKind {
+    EVENT_AQBOT,
+    EVENT_EVAP,
+    EVENT_TOTALEVAP
+};
+
+void BousThermModel::init_events () {
+
+    std::string list = stg->events;
+    size_t i0 = 0, i1;
+    while (i0 < list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        std::string name = list.substr(i0, i1 - i0);
+        i0 = i1 + 1;
+        //ignore spaces around events
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name.length() == 0) continue;
+        //kind@arguments, with a location on the grid for the first two kinds
+        size_t ia = name.find('@');
+        std::string kind = name.substr(0, ia), args = (ia == std::string::npos) ? "" : name.substr(ia + 1);
+        double x = 0.0, y = 0.0, v = 0.0;
+        char end;
+        int n;
+        bool ok;
+        if (kind == "aqbot") {
+            if (Ny > 1) ok = (sscanf(args.c_str(), "%lf:%lf:%lf%c", &x, &y, &v, &end) == 3);
+            else ok = (sscanf(args.c_str(), "%lf:%lf%c", &x, &v, &end) == 2);
+            n = EVENT_AQBOT;
+        } else if (kind == "evap") {
+            if (Ny > 1) ok = (sscanf(args.c_str(), "%lf:%lf%c", &x, &y, &end) == 2);
+            else ok = (sscanf(args.c_str(), "%lf%c", &x, &end) == 1);
+            n = EVENT_EVAP;
+        } else if (kind == "totalevap") {
+            ok = (sscanf(args.c_str(), "%lf%c", &v, &end) == 1);
+            n = EVENT_TOTALEVAP;
         } else {
-            evap[j] = 0.0;
-            evapw[j] = 0.0;
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "FAILURE: events are written aqbot@" << (Ny > 1 ? "x:y:depth, evap@x:y," : "x:depth, evap@x,")
+                      << " or totalevap@value, not " << name << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if ( (n != EVENT_TOTALEVAP) && ( (x < xe[0]) || (x > xe[Nx]) || ( (Ny > 1) && ((y < ye[0]) || (y > ye[Ny])) ) ) ) {
+            std::cout << "FAILURE: event " << name << " is outside the grid" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        //the column at the nearest edge, or the cell containing the point
+        long r = (Ny > 1) ? point_inside(ye, y, Ny+1) : 0;
+        long j = point_inside(xe, x, Nx+1);
+        long je = (x - xe[j] <= xe[j+1] - x) ? j : j + 1;
+        ename.push_back(name);
+        ekind.push_back(n);
+        eloc.push_back( (n == EVENT_AQBOT) ? r*(Nx+1) + je : r*Nx + j );
+        ethresh.push_back(v);
+        eg.push_back(0.0);
+    }
+    if (ename.empty()) return;
+    eHprev = new double[Ncell];
+    escr = new double[get_neq() + 2*Nz];
+    printf("%lu events are detected after every step\n", ename.size());
+}
+
+bool BousThermModel::event_dense (long e) {
+    if (integrator != TRAPZ) return(false);
+    if (ekind[e] == EVENT_EVAP) return(!stg->implicitH);
+    return(ekind[e] == EVENT_AQBOT);
+}
+
+double BousThermModel::column_temps (long k, double *u, double *Tk, double *Tc) {
+
+    double gH;
+    double zedge = f_Hedge(k/(Nx+1), k%(Nx+1), u, &gH) - ztope[k];
+    if (stg->enthalpy) {
+        double lf;
+        for (long i=0; i<Nz; i++)
+            Tc[i] = f_enthalpy_temp(poro[i], Tk[i], zc[i] < zedge ? 1.0 : 0.0, &lf);
+    } else {
+        for (long i=0; i<Nz; i++) Tc[i] = Tk[i];
+    }
+    return(zedge);
+}
+
+double BousThermModel::event_value (long e, double theta) {
+
+    long l = eloc[e];
+    double *u = get_sol();
+    if (ekind[e] == EVENT_AQBOT) {
+        //the column inside the step, from its state at the end
+        double *Tk = escr + get_neq(), *Tc = Tk + Nz;
+        unsigned long i0 = Ncell + Nz*l;
+        for (long i=0; i<Nz; i++)
+            Tk[i] = u[i0+i] - dense_increment(1.0, i0+i) + dense_increment(theta, i0+i);
+        column_temps(l, u, Tk, Tc);
+        double t = etprev + theta*(get_t() - etprev);
+        double Ts = f_surf_temp(t, htope[l], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR);
+        return( f_aquifer_bottom(Tc, Ts) + ethresh[e] );
+    }
+    //the water table inside the step, from its state at the beginning
+    return( eHprev[l] + dense_increment(theta, l) - ztopc[l] );
+}
+
+double BousThermModel::event_now (long e) {
+
+    long l = eloc[e];
+    if (ekind[e] == EVENT_AQBOT) {
+        double *Tc = escr + get_neq();
+        column_temps(l, get_sol(), T[l], Tc);
+        double Ts = f_surf_temp(get_t(), htope[l], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR);
+        return( f_aquifer_bottom(Tc, Ts) + ethresh[e] );
+    }
+    if (ekind[e] == EVENT_EVAP) return( H[l] - ztopc[l] );
+    return( total_evap() - ethresh[e] );
+}
+
+void BousThermModel::event_state (double theta) {
+
+    double *u = get_sol();
+    unsigned long neq = get_neq();
+    for (unsigned long i=0; i<neq; i++) escr[i] = u[i];
+    if (integrator != TRAPZ) return;
+    //water table
+    for (long c=0; c<Ncell; c++) {
+        if (stg->implicitH) escr[c] = eHprev[c] + theta*(H[c] - eHprev[c]);
+        else escr[c] = std::min(eHprev[c] + dense_increment(theta, c), ztopc[c]);
+    }
+    //thermal columns
+    for (unsigned long i=Ncell; i<neq; i++)
+        escr[i] += dense_increment(theta, i) - dense_increment(1.0, i);
+}
+
+void BousThermModel::record_probes_state (double *u, double t) {
+
+    double *Tc = escr + get_neq();
+    pbuf.push_back(t);
+    for (unsigned p=0; p<pname.size(); p++) {
+        long k = pcol[p], c = pcell[p], r = k/(Nx+1), j = k%(Nx+1);
+        double gH;
+        f_Hedge(r, j, u, &gH);
+        double zedge = column_temps(k, u, u + Ncell + Nz*k, Tc);
+        double Ts = f_surf_temp(t, htope[k], stg->Ts0, stg->Tsf, stg->Tsgam, stg->TsLR);
+        double aq = f_aquifer_bottom(Tc, Ts);
+        double Ki = f_Kint(aq, zedge, Tc);
+        pbuf.push_back(Tc[player[p]]);
+        pbuf.push_back(u[c]);
+        pbuf.push_back(f_qH(gH, Ki));
+        pbuf.push_back(Ki);
+        pbuf.push_back(aq);
+        pbuf.push_back(evap[c]);
+    }
+    if (pbuf.size() >= PROBE_BUFFER) flush_probes();
+}
+
+void BousThermModel::detect_events () {
+
+    //crossings over the step, as the fraction of the step and the index
+    std::vector< std::pair<double,long> > found;
+    for (long e=0; e<(long)ename.size(); e++) {
+        bool dense = event_dense(e);
+        double g1 = dense ? event_value(e, 1.0) : event_now(e);
+        if ( (eg[e] < 0.0) != (g1 < 0.0) ) {
+            double theta;
+            if (dense) {
+                //bisect on the sign, from wherever the extension starts
+                bool neg0 = (event_value(e, 0.0) < 0.0);
+                double lo = 0.0, hi = 1.0;
+                if (neg0 == (g1 < 0.0)) hi = 0.0;
+                else {
+                    for (int iter=0; iter<50; iter++) {
+                        double mid = (lo + hi)/2.0;
+                        if ( (event_value(e, mid) < 0.0) == neg0 ) lo = mid;
+                        else hi = mid;
+                    }
+                }
+                theta = hi;
+            } else {
+                theta = eg[e]/(eg[e] - g1);
+            }
+            found.push_back(std::make_pair(theta, e));
         }
+        eg[e] = g1;
+    }
+
+    //trigger them in time order, opening the log only when there are any
+    std::sort(found.begin(), found.end());
+    std::ofstream elog;
+    if (!found.empty()) elog.open((dirout + '/' + "events.txt").c_str(), std::ios::app);
+    for (unsigned f=0; f<found.size(); f++) {
+        double theta = found[f].first;
+        long e = found[f].second;
+        double t = etprev + theta*(get_t() - etprev);
+        const char *dir = (eg[e] < 0.0) ? "falling" : "rising";
+        elog << nevent << ' ' << ename[e] << ' ' << dir << ' ' << std::setprecision(17) << t << ' ' << get_nstep() << std::endl;
+        printf("    event %li: %s %s at %g yr\n", nevent, ename[e].c_str(), dir, t/YEAR_SEC);
+        bool snap = in_list(stg->eventdo, "snap"), probe = in_list(stg->eventdo, "probe") && precord;
+        if (snap || probe) event_state(theta);
+        if (snap) write_double(dirout + '/' + "event_snap_" + std::to_string(nevent), escr, get_neq());
+        if (probe) record_probes_state(escr, (integrator == TRAPZ) ? t : get_t());
+        nevent++;
+    }
+
+    //the next step starts here
+    for (long c=0; c<Ncell; c++) eHprev[c] = H[c];
+    etprev = get_t();
+}
+
+//------------------------------------------------------------------------------
+//delta encoded snaps
+
+template <class F>
+void BousThermModel::snap_field (const std::string &dirout, const char *name, long isnap, F **a, long n, long m) {
+
+    std::string fn = dirout + '/' + name + '_' + std::to_string(isnap);
+    if (!stg->snapdelta) {
+        write_field(fn, a, n, m);
+        return;
     }
+    //the arrays of the field, one after another
+    int w = sizeof(F);
+    std::vector<unsigned char> cur(n*m*w);
+    for (long i=0; i<n; i++)
+        memcpy(cur.data() + i*m*w, a[i], m*w);
+    //by itself at the first snap and every deltakey, otherwise the difference
+    std::vector<unsigned char> &ref = dref[name];
+    bool key = ref.empty() || ( (stg->deltakey > 0) && (isnap % stg->deltakey == 0) );
+    write_delta(fn, cur.data(), key ? NULL : ref.data(), n*m, w);
+    ref.swap(cur);
 }
 
 //------------------------------------------------------------------------------
@@ -347,15 +2244,53 @@ void BousThermModel::update_evaporation () {
 
 void BousThermModel::before_solve () {
 
-    //zero out certain things before starting
-    for (long j=0; j<Nx; j++) {
-        evap[j] = 0.0;
-        evapw[j] = 0.0;
-        cumevap[j] = 0.0;
+    //zero out certain things before starting, unless continuing from a state
+    if (!resumed) {
+        for (long c=0; c<Ncell; c++) {
+            evap[c] = 0.0;
+            evapw[c] = 0.0;
+            cumevap[c] = 0.0;
+        }
+    }
+    //statistics cover this solve, from wherever it starts
+    reset_stats();
+    //the enthalpy of a given state matches its water table
+    if (stg->enthalpy) count_wet();
+    //start the probe stream, describing where the probes are
+    if (!pname.empty()) {
+        std::ofstream pfile((dirout + '/' + "probes.txt").c_str());
+        pfile << "# every " << stg->probeevery << " steps the probes file gets a record of float64 values," << std::endl;
+        pfile << "# the time followed by T H qH Kint aqbot evap for each probe below" << std::endl;
+        pfile << "# probe location column cell layer x z" << std::endl;
+        for (unsigned p=0; p<pname.size(); p++)
+            pfile << p << ' ' << pname[p] << ' ' << pcol[p] << ' ' << pcell[p] << ' ' << player[p]
+                  << ' ' << xe[pcol[p]%(Nx+1)] << ' ' << zc[player[p]] << std::endl;
+        fclose(fopen((dirout + '/' + "probes").c_str(), "wb"));
+        pbuf.clear();
+        precord = true;
+    }
+    //delta encoded fields start with a full snap
+    dref.clear();
+    //start the event log from the initial values of the event functions
+    if (!ename.empty()) {
+        std::ofstream elog((dirout + '/' + "events.txt").c_str());
+        elog << "# event name direction time step" << std::endl;
+        for (long e=0; e<(long)ename.size(); e++) eg[e] = event_now(e);
+        for (long c=0; c<Ncell; c++) eHprev[c] = H[c];
+        etprev = get_t();
+        nevent = 0;
+        erecord = true;
     }
     //write depth dependent physical params
     write_double(dirout + '/' + "poro", poro, Nz);
     write_double(dirout + '/' + "perm", perm, Nz);
+    //tag the data type of the thermal diagnostics, which depends on precision
+    std::ofstream ofile((dirout + '/' + "dtypes.txt").c_str());
+    ofile << "captherm = " << dtype_tag(captherm[0]) << std::endl;
+    ofile << "gradT = " << dtype_tag(gradT[0]) << std::endl;
+    ofile << "qT = " << dtype_tag(qT[0]) << std::endl;
+    ofile << "wsat = " << dtype_tag(wsat[0]) << std::endl;
+    ofile << "isat = " << dtype_tag(isat[0]) << std::endl;
     //start the clock
     start_time = omp_get_wtime();
 }
@@ -364,38 +2299,67 @@ void BousThermModel::after_step (double t) {
 
     (void)t; //suppress unused variable warning
 
-    //update evaporation arrays
-    update_evaporation();
+    //advance the water table if it's implicit, then update evaporation arrays
+    if (stg->implicitH) solve_H_implicit(get_dt());
+    else update_evaporation();
+    //move tiles between threads if called for in settings
+    if ( (stg->nrebal > 0) && (get_nstep() % stg->nrebal == 0) ) rebalance();
     //apply maximum recharge if called for in settings
-    if (stg->Rmax) for (long j=0; j<Nx; j++) H[j] = ztopc[j];
+    if (stg->Rmax) for (long c=0; c<Ncell; c++) H[c] = ztopc[c];
+    //carry the heat of the pore water across the cells the water table crossed
+    if (stg->enthalpy) project_enthalpy();
     //update output vectors
     o_t.push_back( get_t() );
     o_evap.push_back( total_evap() );
     o_evapw.push_back( total_evap_per_width() );
-    o_maxaqbot.push_back( max(aqbot, Nx+1) );
-    o_minaqbot.push_back( min(aqbot, Nx+1) );
+    o_maxaqbot.push_back( max(aqbot, Ncol) );
+    o_minaqbot.push_back( min(aqbot, Ncol) );
+    //find events over the step
+    if (erecord) detect_events();
+    //accumulate the statistics
+    if (stg->stats) update_stats(get_dt());
+    //record the probes
+    if ( precord && (get_nstep() % stg->probeevery == 0) ) record_probes();
+    //save the state in the spin-up library if called for
+    if ( !spinsteps.empty() && (get_nstep() == spinsteps.front()) ) {
+        save_state(spindir + "/state_" + std::to_string(get_nstep()));
+        printf("    spin-up state saved after step %llu (%g yr)\n", get_nstep(), get_t()/YEAR_SEC);
+        spinsteps.erase(spinsteps.begin());
+    }
+    //advance the sensitivities over the step
+    if (!smod.empty()) step_sensitivity();
 }
 
 void BousThermModel::after_snap (std::string dirout, long isnap, double t) {
 
     (void)t; //suppress unused variable warning
 
-    //write a bunch of files
+    //compute all the diagnostics from the current state
+    update_diagnostics();
+    //put the probe records on disk, so they're there if the trial stops
+    if (precord) flush_probes();
+
+    //write whichever files are called for in the settings
     std::string sisnap = std::to_string(isnap);
-    write_double(dirout + '/' + "gradH_" + sisnap, gradH, Nx+1);
-    write_double(dirout + '/' + "Hedge_" + sisnap, Hedge, Nx+1);
-    write_double(dirout + '/' + "qH_" + sisnap, qH, Nx+1);
-    write_double(dirout + '/' + "Kint_" + sisnap, Kint, Nx+1);
-    write_double(dirout + '/' + "Tsurf_" + sisnap, Tsurf, Nx+1);
-    write_double(dirout + '/' + "aqbot_" + sisnap, aqbot, Nx+1);
-    write_double(dirout + '/' + "evap_" + sisnap, evap, Nx);
-    write_double(dirout + '/' + "evapw_" + sisnap, evapw, Nx);
-    write_double(dirout + '/' + "cumevap_" + sisnap, cumevap, Nx);
-    write_doubles(dirout + '/' + "captherm_" + sisnap, captherm, Nx+1, Nz);
-    write_doubles(dirout + '/' + "gradT_" + sisnap, gradT, Nx+1, Nz+1);
-    write_doubles(dirout + '/' + "qT_" + sisnap, qT, Nx+1, Nz+1);
-    write_doubles(dirout + '/' + "wsat_" + sisnap, wsat, Nx+1, Nz);
-    write_doubles(dirout + '/' + "isat_" + sisnap, isat, Nx+1, Nz);
+    if (diag("gradH")) write_double(dirout + '/' + "gradH_" + sisnap, gradH, Ncol);
+    if (diag("Hedge")) write_double(dirout + '/' + "Hedge_" + sisnap, Hedge, Ncol);
+    if (diag("qH")) write_double(dirout + '/' + "qH_" + sisnap, qH, Ncol);
+    if (diag("Kint")) write_double(dirout + '/' + "Kint_" + sisnap, Kint, Ncol);
+    if (diag("Tsurf")) write_double(dirout + '/' + "Tsurf_" + sisnap, Tsurf, Ncol);
+    if (diag("aqbot")) write_double(dirout + '/' + "aqbot_" + sisnap, aqbot, Ncol);
+    if (diag("evap")) write_double(dirout + '/' + "evap_" + sisnap, evap, Ncell);
+    if (diag("evapw")) write_double(dirout + '/' + "evapw_" + sisnap, evapw, Ncell);
+    if (diag("cumevap")) write_double(dirout + '/' + "cumevap_" + sisnap, cumevap, Ncell);
+    if (diag("captherm")) snap_field(dirout, "captherm", isnap, captherm, Ncol, Nz);
+    if (diag("gradT")) snap_field(dirout, "gradT", isnap, gradT, Ncol, Nz+1);
+    if (diag("qT")) snap_field(dirout, "qT", isnap, qT, Ncol, Nz+1);
+    if (diag("wsat")) snap_field(dirout, "wsat", isnap, wsat, Ncol, Nz);
+    if (diag("isat")) snap_field(dirout, "isat", isnap, isat, Ncol, Nz);
+    if (stg->enthalpy && diag("T")) snap_field(dirout, "T", isnap, temp, Ncol, Nz);
+    if (Ny > 1) {
+        if (diag("gradHy")) write_double(dirout + '/' + "gradHy_" + sisnap, gradHy, (Ny+1)*Nx);
+        if (diag("qHy")) write_double(dirout + '/' + "qHy_" + sisnap, qHy, (Ny+1)*Nx);
+    }
     //print some info
     int h, m;
     double s;
@@ -404,15 +2368,60 @@ void BousThermModel::after_snap (std::string dirout, long isnap, double t) {
     printf("      total wall time (HMS) ...... %02d:%02d:%04.1f\n", h, m, s);
     printf("      time steps taken ........... %llu\n", nstep_);
     printf("      average time per step ...... %g sec/step\n", ttot/double(get_nstep()));
+    if (integrator == RKC) {
+        printf("      RKC stages (min/mean/max) .. %li/%.1f/%li\n", nstage_min, double(nstage_sum)/double(std::max(nstage_steps, 1L)), nstage_max);
+        printf("      spectral radius estimate ... %g 1/s\n", rho);
+        reset_stage_counts();
+    }
+    if (integrator == LTS) {
+        printf("      column substeps (mean/max) . %.1f/%li per step\n", double(nsub_sum)/double(std::max(nsub_steps, 1L)*Ncol), nsub_max);
+        printf("      column updates saved ....... %.1f %%\n", 100*(1.0 - double(nsub_sum)/double(std::max(nsub_all, 1L))));
+        nsub_sum = 0;
+        nsub_all = 0;
+        nsub_max = 0;
+        nsub_steps = 0;
+    }
+    printf("      thread load imbalance ...... %.1f %% (%li rebalances)\n", 100*load_imbalance(), nrebal);
+    for (int t=0; t<nthr; t++) tbusy[t] = 0.0;
     printf("      model time ................. %g yr\n", get_t()/YEAR_SEC);
     printf("      water table depth range .... [%.2e, %.2e] m\n", min_H_depth(), max_H_depth());
-    printf("      hydraulic gradient range ... [%.2e, %.2e] %%\n", 100*absmin(gradH, Nx-1), 100*absmax(gradH, Nx-1));
-    printf("      Kint range ................. [%.2e, %.2e] m^2/s\n", min(Kint, Nx+1), max(Kint, Nx+1));
-    printf("      total evap ................. %g m^2/s\n", total_evap());
-    printf("      total evap per width ....... %g m/s\n", total_evap_per_width());
-    printf("      surface temp range ......... [%.2e, %.2e] K\n", min(Tsurf, Nx+1), max(Tsurf, Nx+1));
-    printf("      temperature range .......... [%.2e, %.2e] K\n", min(T, Nx+1, Nz), max(T, Nx+1, Nz));
-    printf("      max freezing point dep ..... %g m\n", absmax(aqbot, Nx+1));
+    printf("      hydraulic gradient range ... [%.2e, %.2e] %%\n", 100*absmin(gradH, Ncol-1), 100*absmax(gradH, Ncol-1));
+    printf("      Kint range ................. [%.2e, %.2e] m^2/s\n", min(Kint, Ncol), max(Kint, Ncol));
+    if (Ny > 1) {
+        printf("      total evap ................. %g m^3/s\n", total_evap());
+        printf("      total evap per area ........ %g m/s\n", total_evap_per_width());
+    } else {
+        printf("      total evap ................. %g m^2/s\n", total_evap());
+        printf("      total evap per width ....... %g m/s\n", total_evap_per_width());
+    }
+    printf("      surface temp range ......... [%.2e, %.2e] K\n", min(Tsurf, Ncol), max(Tsurf, Ncol));
+    printf("      temperature range .......... [%.2e, %.2e] K\n", min(temp, Ncol, Nz), max(temp, Ncol, Nz));
+    printf("      max freezing point dep ..... %g m\n", absmax(aqbot, Ncol));
+    for (unsigned p=0; p<smod.size(); p++) {
+        std::string lab = "d(total evap)/d(" + sname[p] + ") ";
+        lab.resize(std::max(lab.length(), size_t(28)), '.');
+        printf("      %s %g\n", lab.c_str(), o_devap[p].empty() ? 0.0 : o_devap[p].back());
+    }
+    //stability limits of the current state
+    stable_dt();
+    print_stable_dt();
+    //convergence of the implicit water table
+    if (stg->implicitH) {
+        printf("      most Picard iterations ..... %li (%li unconverged)\n", npic_max, npic_fail);
+        npic_max = 0;
+        npic_fail = 0;
+    }
+    //report the worst storage error of the diagnostics since the last snap
+    if (stg->precval) {
+        double e[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+        for (int t=0; t<nthr; t++) {
+            for (int i=0; i<5; i++) {
+                e[i] = std::max(e[i], perr[t][i]);
+                perr[t][i] = 0.0;
+            }
+        }
+        printf("      storage error (gradT, qT, captherm rel; wsat, isat abs) ... %.1e %.1e %.1e %.1e %.1e\n", e[0], e[1], e[2], e[3], e[4]);
+    }
     std::cout << std::endl;
 
     //check that the solution hasn't gone off the rails
@@ -431,19 +2440,44 @@ void BousThermModel::after_solve () {
     write_double_vec(dirout + '/' + "o_evapw", sub_vec(o_evapw, n));
     write_double_vec(dirout + '/' + "o_maxaqbot", sub_vec(o_maxaqbot, n));
     write_double_vec(dirout + '/' + "o_minaqbot", sub_vec(o_minaqbot, n));
+    for (unsigned p=0; p<smod.size(); p++) {
+        write_double_vec(dirout + '/' + "o_devap_" + sname[p], sub_vec(o_devap[p], n));
+        write_double_vec(dirout + '/' + "o_dmaxaqbot_" + sname[p], sub_vec(o_dmaxaqbot[p], n));
+        write_double_vec(dirout + '/' + "o_dminaqbot_" + sname[p], sub_vec(o_dminaqbot[p], n));
+    }
+    if (stg->stats) write_stats();
+    if (precord) {
+        flush_probes();
+        precord = false;
+    }
+    erecord = false;
 }
 
 //------------------------------------------------------------------------------
 //dynamic instantiation function
 
-BousThermModel init_model (std::string &griddir, Settings *stg, const char *dirout) {
+//size of the system of ODEs for a grid
+static long model_neq (std::string &griddir) {
 
     //number of vertical (z) nodes
     long Nz = read_one_long(griddir, "Nz.txt");
     //number of horizontal (x) nodes
     long Nx = read_one_long(griddir, "Nx.txt");
+    //number of rows, if the grid is a map-view domain
+    long Ny = 1;
+    if ( file_exists(griddir, "Ny.txt") ) Ny = read_one_long(griddir, "Ny.txt");
+
+    return( Ny*(Nz*(Nx+1) + Nx) );
+}
+
+BousThermModel init_model (std::string &griddir, Settings *stg, const char *dirout) {
+
     //initialize a model object
-    BousThermModel model(griddir, Nz*(Nx+1) + Nx, stg, dirout);
+    BousThermModel model(griddir, model_neq(griddir), stg, dirout);
     //return the model
     return(model);
 }
+
+BousThermModel *new_model (std::string &griddir, Settings *stg, const char *dirout) {
+    return( new BousThermModel(griddir, model_neq(griddir), stg, dirout) );
+}
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 
 #include "omp.h"
 
@@ -14,9 +15,38 @@
 #include "bous_therm_settings.h"
 #include "bous_therm_numerics.h"
 
+//------------------------------------------------------------------------------
+//storage precision
+
+#ifdef MIXED_PRECISION
+//!storage type of the thermal diagnostics (gradients, fluxes, capacities)
+typedef float diag_t;
+//!storage type of saturation fractions, in increments of 1/255
+typedef unsigned char sat_t;
+//!converts a saturation fraction into its storage type
+inline sat_t to_sat (double f) { return( sat_t(f*255.0 + 0.5) ); }
+//!converts a stored saturation fraction back into a fraction
+inline double from_sat (sat_t s) { return( double(s)/255.0 ); }
+#else
+//!storage type of the thermal diagnostics (gradients, fluxes, capacities)
+typedef double diag_t;
+//!storage type of saturation fractions
+typedef double sat_t;
+//!converts a saturation fraction into its storage type
+inline sat_t to_sat (double f) { return(f); }
+//!converts a stored saturation fraction back into a fraction
+inline double from_sat (sat_t s) { return(s); }
+#endif
+
 //!top-level modeling class implementing initialization, the ODE function, and output
 /*!
 BousThermModel is the main modeling class, inheriting from BousThermNumerics. The class defines functions for initializing the model, evaluating the spatial discretization of the shallow groundwater equation (Boussinesq equation) in finite-volume form, evaluating the spatial discretization of the heat equation in finite-volume form also, and managing output.
+
+The prognostic water table and temperatures are always double precision. If the model is compiled with `MIXED_PRECISION` defined, the thermal diagnostics are stored as floats and the saturation fractions as bytes, which halves the memory traffic and output volume of those fields. They are always computed in double precision, so the solution is unaffected by the storage type.
+
+With the `enthalpy` setting, the thermal state of every cell is volumetric enthalpy instead of temperature. Temperature and the liquid fraction of pore water are recovered from enthalpy cell by cell, and the phase change at the freezing point is a plateau in temperature rather than a spike in the apparent heat capacity, so the explicit step is only limited by the sensible heat capacity.
+
+The solution array holds the water table in all Ncell hydraulic cells followed by the temperature profiles of all Ncol thermal columns, both ordered row by row as described in BousThermGrid. For a transect this is Nx water table values followed by Nx+1 temperature columns.
 */
 class BousThermModel : public BousThermNumerics {
 
@@ -33,6 +63,36 @@ public:
     //!destructs
     ~BousThermModel ();
 
+    //!allocates and initializes column arrays and the initial state, tile by tile
+    /*!
+    Every tile is touched first by the thread that owns it in the statically scheduled loops of ode_fun(), so on multi-socket machines the memory for each tile lands on the socket that works on it.
+    */
+    void first_touch ();
+
+    //!computes the physical parameters that depend on the settings, ktherm, poro_surf, and the porosity and permeability profiles
+    void set_params ();
+
+    //!sets the initial state of a thermal column and of the hydraulic cell to its right, and zeroes the cell's evaporation trackers
+    /*!
+    With the enthalpy formulation the column is left in temperature, for init_enthalpy() once the whole water table is set.
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    */
+    void init_column (long r, long j);
+
+    //!converts the initial temperatures of a thermal column to enthalpy
+    /*!
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    */
+    void init_enthalpy (long r, long j);
+
+    //!returns the model to the initial state of its settings, without allocating anything
+    /*!
+    The parameters are recomputed from the settings, which may have changed since construction, the time and step count go back to zero, and the integrator, the implicit water table, the output vectors, and the statistics start over, so the next integration is the same as a new model's. Drivers that run many trials on the same grid reuse models this way.
+    */
+    void restart ();
+
     //!output directory
     std::string dirout;
 
@@ -42,7 +102,7 @@ public:
     //------------------------------------------------------------------
     //aliases
 
-    //!alias for part of the solution array containing temperatures
+    //!alias for part of the solution array containing temperatures, or enthalpies with the enthalpy formulation
     double **T;
     //!alias for part of the solution array containing water table heights
     double *H;
@@ -70,10 +130,12 @@ public:
     double poro_surf;
 
     //dynamic physical parameters and trackers
-    //!groundwater flux
+    //!groundwater flux across horizontal (x) cell edges
     double *qH;
+    //!groundwater flux across row (y) faces, (Ny+1)*Nx values, only used for map-view domains
+    double *qHy;
     //!heat flux
-    double **qT;
+    diag_t **qT;
     //!vertically integrated hydraulic conductivity
     double *Kint;
     //!surface temperatures
@@ -81,19 +143,21 @@ public:
     //!aquifer bottom locations
     double *aqbot;
     //!thermal capacity with depth
-    double **captherm;
+    diag_t **captherm;
     //!water saturation fraction
-    double **wsat;
+    sat_t **wsat;
     //!ice saturation fraction
-    double **isat;
+    sat_t **isat;
 
     //storage for some derivatives and such
     //!gradient of water table
     double *gradH;
+    //!gradient of water table across row (y) faces
+    double *gradHy;
     //!water table values at cell edges
     double *Hedge;
     //!gradient of temperature profile
-    double **gradT;
+    diag_t **gradT;
 
     //------------------------------------------------------------------
     //trackers, snappers, monitors
@@ -116,6 +180,484 @@ public:
     //!minimum aquifer bottom elevation
     std::vector<double> o_minaqbot;
 
+    //------------------------------------------------------------------
+    //load balancing
+
+    //!number of threads sharing the tiles
+    int nthr;
+    //!tile ownership, thread t owns tiles tb[t] through tb[t+1]-1
+    long *tb;
+    //!wall time spent in each tile since the last rebalance
+    double *tcost;
+    //!wall time each thread has spent working since the last snap
+    double *tbusy;
+    //!number of times the tiles have been repartitioned
+    long nrebal;
+
+    //!splits the tiles into contiguous per-thread ranges of equal cost
+    /*!
+    The cost of each tile is read from `tcost`.
+    */
+    void partition_tiles ();
+
+    //!repartitions the tiles using their measured cost since the last call
+    void rebalance ();
+
+    //!computes the relative excess of the busiest thread's work time over the average
+    double load_imbalance ();
+
+    //!worst storage errors of the diagnostics for each thread, when validating precision
+    double **perr;
+
+    //------------------------------------------------------------------
+    //diagnostics
+
+    //!whether ode_fun() stores the full set of diagnostic fields
+    /*!
+    The time stepping only needs the prognostic time derivatives, plus qH, Kint, and aqbot, which couple the columns or are monitored every step. Everything else (gradH, Hedge, gradT, qT, captherm, wsat, isat, and the fluxes between rows) is only stored when this flag is set by update_diagnostics().
+    */
+    bool diagnose;
+    //!scratch time derivatives for diagnostic evaluations
+    double *fdiag;
+
+    //------------------------------------------------------------------
+    //enthalpy formulation
+
+    //!temperatures, the same as T unless the state is enthalpy, then recovered at diagnostic evaluations
+    double **temp;
+    //!scratch temperature column for each thread
+    double **tcol;
+    //!scratch liquid fraction column for each thread
+    double **lcol;
+    //!number of saturated cells at the bottom of each column when its enthalpy was last projected
+    long *nwet;
+
+    //!number of cells below the water table of a thermal column
+    /*!
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    */
+    long wet_cells (long r, long j);
+
+    //!sets nwet from the current water table, for a state whose enthalpy already matches it
+    void count_wet ();
+
+    //!moves the enthalpy of the cells the water table crossed over to their new saturation at their current temperatures
+    /*!
+    Water leaving a cell takes its sensible and latent heat with it, and water arriving comes at the cell's temperature, as in the temperature formulation.
+    */
+    void project_enthalpy ();
+
+    //!recomputes and stores every diagnostic field from the current state
+    void update_diagnostics ();
+
+    //!checks whether a diagnostic field is selected for output by the `diagout` setting
+    /*!
+    \param[in] name name of the field
+    */
+    bool diag (const char *name);
+
+    //------------------------------------------------------------------
+    //implicit groundwater flow
+
+    //!water table at the beginning of the step
+    double *Hold;
+    //!flow into each hydraulic cell across the row faces, held fixed during the implicit solve (m^2/s per unit length)
+    double *hsrc;
+    //!whether each hydraulic cell is held at the surface, where the excess inflow evaporates
+    bool *hsurf;
+    //!tridiagonal systems and scratch for each thread, 10 arrays of Nx values each
+    double **tdsys;
+    //!most Picard iterations used by an implicit solve since the last snap
+    long npic_max;
+    //!number of implicit solves that stopped before converging since the last snap
+    long npic_fail;
+
+    //!computes the vertically integrated conductivity of a column for a given water table
+    /*!
+    Uses the temperatures of the current solution and the surface temperature of the last evaluation of the ode function.
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    \param[in] Hc water table array
+    */
+    double column_Kint (long r, long j, double *Hc);
+
+    //!advances the water table by one step with backward Euler along x
+    /*!
+    Each row is a tridiagonal system with Picard-lagged transmissivities, and an active set holds cells at the surface. Flow across the row faces of map-view grids is explicit, and the evaporation arrays are filled here instead of by update_evaporation().
+    \param[in] dt time step
+    */
+    void solve_H_implicit (double dt);
+
+    //------------------------------------------------------------------
+    //stable time step
+
+    //!stability limit of an explicit step from heat conduction in the columns (s)
+    double dtlim_T;
+    //!stability limit of an explicit step from groundwater flow (s)
+    double dtlim_H;
+    //!column and cell where the thermal limit binds
+    long klim_T, ilim_T;
+    //!hydraulic cell where the groundwater limit binds
+    long clim_H;
+
+    //!estimates the largest stable step of the trapezoidal method from the current diagnostic fields
+    /*!
+    The thermal limit of each cell uses ktherm, delz, and captherm, and the groundwater limit of each cell uses Kint, the cell widths, and the porosity at the water table. With the implicit water table solve, only flow across the row faces limits the step. Each cell's Gershgorin disc bounds the eigenvalues of the diffusion operator it contributes, and the trapezoidal method is stable for real eigenvalues down to -2/dt, so each limit is 2 over the largest disc radius. The diagnostic fields must be current, from update_diagnostics().
+    \return the smaller of dtlim_T and dtlim_H
+    */
+    double stable_dt ();
+
+    //!estimates the largest stable step of heat conduction in a single column, from its diagnostic capacities
+    /*!
+    \param[in] k index of the column
+    \param[out] ilim cell where the limit binds
+    \return stability limit of the trapezoidal method for the column (s)
+    */
+    double column_dtlim (long k, long *ilim);
+
+    //!prints the stability limits and where on the grid they bind
+    void print_stable_dt ();
+
+    //!integrates with the model's own time loop, for automatic steps or a persistent thread team
+    /*!
+    With automatic steps, the limits are estimated every `ndt` steps, and the step is the smaller of `dtsafe` times the limit and dtmax, otherwise every step is dtmax. Steps are shortened to land on the snap times, which are evenly spaced from time zero, so a solve starting later keeps the numbering of the snaps after its start.
+
+    With a persistent team, one parallel region spans the whole integration. Every thread runs the time loop, the ode function is evaluated collectively with orphaned loops over tiles, the vector updates of the trapezoidal method are shared, and the bookkeeping after each step is done by one thread while the others wait at a barrier. This replaces a fork and join per evaluation with a few barriers.
+    \param[in] tint duration of the integration (s)
+    \param[in] dtmax largest step allowed (s)
+    \param[in] nsnap number of snaps from time zero, evenly spaced in time
+    \param[in] dirout output directory for snaps
+    \param[in] autodt whether to choose steps from the stability limits
+    \param[in] persist whether to use a persistent thread team, only with the trapezoidal method
+    */
+    void solve_loop (double tint, double dtmax, int nsnap, const char *dirout, bool autodt, bool persist);
+
+    //------------------------------------------------------------------
+    //local time stepping
+
+    //!time integral of the groundwater flux across each column's edge over the current step (m^2)
+    double *qHint;
+    //!groundwater flux across each column's edge at the beginning of the current step
+    double *qH0;
+    //!stage input for the columns, the water table part is frozen over a step
+    double *ltsin;
+    //!stage output for the columns
+    double *ltsout;
+    //!scratch slope column for each thread
+    double **ltsf;
+    //!total column substeps since the last snap
+    long nsub_sum;
+    //!most substeps of any column in one step since the last snap
+    long nsub_max;
+    //!number of steps since the last snap
+    long nsub_steps;
+    //!column substeps that a single step size for every column would have needed since the last snap
+    long nsub_all;
+
+    //!advances the solution by one step with local time stepping
+    /*!
+    The water table is frozen over the step while each thermal column takes substeps sized by its own stability limit, and the integrated groundwater fluxes are exchanged at the end, so the step is only limited by groundwater flow.
+    \param[in] dt time step
+    */
+    void step_local (double dt);
+
+    //!advances a single thermal column over a step in its own substeps
+    /*!
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    \param[in] t0 time at the beginning of the step
+    \param[in] dt time step
+    \return number of substeps taken
+    */
+    long column_substeps (long r, long j, double t0, double dt);
+
+    //------------------------------------------------------------------
+    //exponential time differencing
+
+    //!time derivatives at the beginning of the step
+    double *etdf0;
+    //!state after the first stage
+    double *etdu;
+    //!time derivatives after the first stage
+    double *etdf1;
+    //!scratch columns for each thread, the three diagonals of the operator and two vectors
+    double **etdcol;
+    //!complex scratch for the tridiagonal solves of each thread
+    std::complex<double> **etdz;
+
+    //!builds the linear conduction operator of a column from its diagnostic capacities
+    /*!
+    The operator holds the conduction between cells and from the top cell to the surface temperature, which is part of the remainder along with the geothermal flux and any change of the capacities. With the enthalpy formulation, the operator acts on enthalpy through the sensible capacities.
+    \param[in] k index of the column
+    \param[out] a sub-diagonal
+    \param[out] b diagonal
+    \param[out] c super-diagonal
+    */
+    void column_operator (long k, double *a, double *b, double *c);
+
+    //!advances the solution by one step with second order exponential time differencing
+    /*!
+    This is the ETD2RK method of Cox and Matthews, with each column's conduction operator frozen at the beginning of the step and integrated exactly. The water table is advanced with the explicit trapezoidal method, so the step is still limited by groundwater flow.
+    \param[in] dt time step
+    */
+    void step_exponential (double dt);
+
+    //------------------------------------------------------------------
+    //propagation
+
+    //!integrates from a given state over an interval in fixed steps, without snapping or writing anything
+    /*!
+    The output vectors, evaporation trackers, and statistics are cleared first, so afterward they hold the record of this interval alone. This is the propagator used by parareal integration.
+    \param[in] u0 state at the beginning of the interval
+    \param[in] t0 time at the beginning of the interval
+    \param[in] t1 time at the end of the interval
+    \param[in] nstep number of steps
+    \param[out] u1 state at the end of the interval
+    */
+    void propagate (double *u0, double t0, double t1, long nstep, double *u1);
+
+    //------------------------------------------------------------------
+    //spin-up states
+
+    //!directory of the spin-up library entry that states are saved in, empty for no saving
+    std::string spindir;
+    //!steps after which the state is saved in the spin-up library, in increasing order
+    std::vector<unsigned long> spinsteps;
+    //!whether the state was loaded from a file, so the evaporation trackers carry on instead of starting from zero
+    bool resumed;
+
+    //!writes the solution, time, step count, evaporation trackers, and output vectors to a binary file
+    /*!
+    The file is written under a temporary name and renamed, so a file with the final name is always complete.
+    \param[in] fn path to the file
+    */
+    void save_state (const std::string &fn);
+
+    //!sets the number of steps taken, for an integration that continues from a state reached some other way
+    /*!
+    \param[in] n number of steps
+    */
+    void set_nstep (unsigned long long n);
+
+    //!reads a file written by save_state(), continuing the integration from it
+    /*!
+    \param[in] fn path to the file
+    */
+    void load_state (const std::string &fn);
+
+    //------------------------------------------------------------------
+    //grid sequencing
+
+    //!sets the state from a model on a coarser version of the same grid
+    /*!
+    The coarse grid must be made by coarsen_grid(). The empty pore space and the heat of each coarse cell are kept, and a warning is printed if the pore water or the heat of the shared columns changes.
+    \param[in] C model on the coarse grid
+    */
+    void prolong (BousThermModel *C);
+
+    //------------------------------------------------------------------
+    //forward sensitivity
+
+    //!names of the parameters that the output vectors are differentiated by
+    std::vector<std::string> sname;
+    //!perturbation of each parameter
+    std::vector<double> sdp;
+    //!settings with each parameter perturbed
+    std::vector<Settings*> sstg;
+    //!model with each parameter perturbed, which evaluates the ode function with it
+    std::vector<BousThermModel*> smod;
+    //!derivative of the solution by each parameter
+    std::vector<double*> ssol;
+    //!solution at the beginning of the current step
+    double *sprev;
+    //!time at the beginning of the current step
+    double tprev;
+    //!scratch space for the sensitivity steps, six solutions long
+    double *sscr;
+    //!output derivatives of evaporation by each parameter
+    std::vector< std::vector<double> > o_devap;
+    //!output derivatives of the maximum aquifer bottom elevation by each parameter
+    std::vector< std::vector<double> > o_dmaxaqbot;
+    //!output derivatives of the minimum aquifer bottom elevation by each parameter
+    std::vector< std::vector<double> > o_dminaqbot;
+
+    //!sets up the sensitivities to the parameters named in the `sensitivity` setting
+    /*!
+    A model is built for each parameter, with the parameter raised by `sensrel` times its value, and the derivative of the solution starts as the difference of the initial states over the perturbation, which is nonzero for parameters of the initial profiles. Must be called before integrating from the initial state.
+    \param[in] griddir path to the grid directory
+    */
+    void init_sensitivity (std::string &griddir);
+
+    //!advances the derivatives of the solution by the parameters over the step just taken
+    /*!
+    This is the tangent linear model of the trapezoidal step, with the derivatives of the ode function taken as directional differences with the perturbed models.
+    */
+    void step_sensitivity ();
+
+    //------------------------------------------------------------------
+    //in-situ statistics
+
+    //!time the statistics started accumulating (s)
+    double stat_t0;
+    //!time integral of evaporation in each hydraulic cell (m)
+    double *stat_evap;
+    //!lowest aquifer bottom of each column (m)
+    double *stat_minaqbot;
+    //!highest aquifer bottom of each column (m)
+    double *stat_maxaqbot;
+    //!time each column first thawed at the surface (s), -1 if it hasn't
+    double *stat_thaw;
+    //!time integral of the groundwater flux across each column's edge (m^2)
+    double *stat_qH;
+    //!time spent by each hydraulic cell's water table in each depth bin (s), statbins values per cell
+    double *stat_Hdep;
+
+    //!starts the statistics over from the current time
+    void reset_stats ();
+
+    //!adds the step just taken to the statistics
+    /*!
+    Every quantity is taken at the end of the step and held over it, like the cumulative evaporation, so the integrals are sums over steps. A column thaws when its aquifer bottom drops below the surface. The water table depth histogram of each cell has `statbins` equal bins from the surface down to `statdmax`, with deeper tables in the last bin.
+    \param[in] dt the step
+    */
+    void update_stats (double dt);
+
+    //!writes the statistics to the output directory
+    /*!
+    The files are stat_t (the start and end of the statistics), stat_evap, stat_minaqbot, stat_maxaqbot, stat_thaw, stat_qH (the mean flux), stat_Hdep (the fraction of time in each depth bin, cell by cell), and stat_Hdepbins (the edges of the bins).
+    */
+    void write_stats ();
+
+    //------------------------------------------------------------------
+    //probes
+
+    //!location of each probe as written in the settings
+    std::vector<std::string> pname;
+    //!thermal column of each probe, at the horizontal edge nearest to it
+    std::vector<long> pcol;
+    //!hydraulic cell containing each probe
+    std::vector<long> pcell;
+    //!thermal cell containing each probe in its column
+    std::vector<long> player;
+    //!probe records not yet appended to the stream
+    std::vector<double> pbuf;
+    //!whether the probes are recording, which they do from before_solve() to after_solve()
+    bool precord;
+
+    //!locates the probes in the `probes` setting on the grid
+    void init_probes ();
+
+    //!appends a record of the probes to the buffer, and the buffer to the stream when it's full
+    /*!
+    A record is the time followed by, for each probe, the temperature of its thermal cell, the water table and evaporation of its hydraulic cell, and the groundwater flux, integrated conductivity, and aquifer bottom of its column, as of the last evaluation of the ode function.
+    */
+    void record_probes ();
+
+    //!appends the buffered probe records to the `probes` file in the output directory
+    void flush_probes ();
+
+    //------------------------------------------------------------------
+    //events
+
+    //!event as written in the settings
+    std::vector<std::string> ename;
+    //!kind of each event, 0 for an aquifer bottom depth, 1 for evaporation in a cell, 2 for total evaporation
+    std::vector<int> ekind;
+    //!column or cell of each event
+    std::vector<long> eloc;
+    //!threshold of each event
+    std::vector<double> ethresh;
+    //!value of each event function at the end of the last step
+    std::vector<double> eg;
+    //!water table at the end of the last step
+    double *eHprev;
+    //!time at the end of the last step
+    double etprev;
+    //!solution at an event, and two scratch columns
+    double *escr;
+    //!number of events found in the solve so far
+    long nevent;
+    //!whether events are detected, which they are from before_solve() to after_solve()
+    bool erecord;
+
+    //!reads the events in the `events` setting and locates them on the grid
+    void init_events ();
+
+    //!whether an event function is evaluated inside the last step with the continuous extension of the trapezoidal method
+    /*!
+    Otherwise the function is interpolated linearly between the ends of the step.
+    \param[in] e index of the event
+    */
+    bool event_dense (long e);
+
+    //!evaluates an event function inside the last step, with the continuous extension of the trapezoidal method
+    /*!
+    For an aquifer bottom event, the function is the aquifer bottom of the column's interpolated temperatures plus the depth, and for a cell's evaporation event it's the height of the interpolated water table above the surface, before any is taken out as evaporation.
+    \param[in] e index of the event
+    \param[in] theta fraction of the step
+    */
+    double event_value (long e, double theta);
+
+    //!evaluates an event function at the current state
+    /*!
+    \param[in] e index of the event
+    */
+    double event_now (long e);
+
+    //!fills escr with the solution inside the last step
+    /*!
+    With the trapezoidal method, the solution follows its continuous extension, with the water table no higher than the surface. With an implicit water table, the water table is linear between the ends of the step. With the other methods, the solution is the one at the end of the step.
+    \param[in] theta fraction of the step
+    */
+    void event_state (double theta);
+
+    //!temperatures of a thermal column of a solution, recovered from enthalpy if necessary
+    /*!
+    \param[in] k index of the column
+    \param[in] u solution array
+    \param[in] Tk thermal state of the column, which may be outside u
+    \param[out] Tc temperatures of the column
+    \return water table of the column relative to its surface
+    */
+    double column_temps (long k, double *u, double *Tk, double *Tc);
+
+    //!appends a record of the probes computed from a solution to the buffer
+    /*!
+    The record is the same as record_probes() writes, with the groundwater flux, integrated conductivity, and aquifer bottom computed from the solution, and the evaporation of the last step.
+    \param[in] u solution array
+    \param[in] t time of the solution
+    */
+    void record_probes_state (double *u, double t);
+
+    //!finds the events whose functions changed sign over the last step, locates them, and triggers what `eventdo` calls for
+    /*!
+    Crossings are located by bisection on the continuous extension of the step, or linearly between the ends of the step, so the steps are never shortened. Each event is logged to `events.txt`, and in time order, a snapshot of the solution at the event is written to `event_snap_<n>`, and a record of the probes computed from that solution is appended to the probe stream.
+    */
+    void detect_events ();
+
+    //------------------------------------------------------------------
+    //delta encoded snaps
+
+    //!bytes of the last snap of each delta encoded field
+    std::map<std::string, std::vector<unsigned char> > dref;
+
+    //!writes a two-dimensional field at a snap, delta encoded with write_delta() if `snapdelta` is set
+    /*!
+    A field is written by itself at its first snap of the solve and every `deltakey` snaps, and otherwise as its difference from the previous snap, which is kept in dref.
+    \param[in] dirout path to output directory
+    \param[in] name name of the field
+    \param[in] isnap index of the snap
+    \param[in] a the field, n arrays of m values
+    \param[in] n number of arrays
+    \param[in] m length of each array
+    */
+    template <class F>
+    void snap_field (const std::string &dirout, const char *name, long isnap, F **a, long n, long m);
+
+    //------------------------------------------------------------------
+    //trackers, snappers, monitors (continued)
+
     //!wall clock start time
     double start_time;
     //!computes total evaporation at current model state
@@ -179,6 +721,18 @@ public:
     */
     double f_dHdt (double fl, double fr, double po, double delx);
 
+    //!computes saturation fractions (ice and water) for a single cell
+    /*!
+    \param[in] i index of the cell in the column
+    \param[in] fidx index of the cell containing the aquifer bottom
+    \param[in] zedge water table height of column in z coordinates
+    \param[in] aqbot aquifer bottom elevation
+    \param[in] temp temperature of the cell
+    \param[out] sw water sat frac
+    \param[out] si ice sat frac
+    */
+    void f_sat (long i, long fidx, double zedge, double aqbot, double temp, double *sw, double *si);
+
     //!computes saturation fractions (ice and water) for a temperature column
     /*!
     \param[in] zedge water table height of column in z coordinates
@@ -189,13 +743,50 @@ public:
     */
     void update_sat (double zedge, double aqbot, double *Tin, double *sw, double *si);
 
+    //!computes the water table and its gradient at a horizontal cell edge
+    /*!
+    \param[in] r row of the edge
+    \param[in] j horizontal index of the edge
+    \param[in] Hin water table array
+    \param[out] gH hydraulic gradient at the edge
+    \return water table at the edge, no higher than the surface
+    */
+    double f_Hedge (long r, long j, double *Hin, double *gH);
+
+    //!computes gradients, fluxes, and thermal time derivatives for a single thermal column
+    /*!
+    \param[in] r row of the column
+    \param[in] j horizontal edge of the column
+    \param[in] t time of the evaluation, for the surface temperature
+    */
+    void ode_column (long r, long j, double t);
+
+    //!computes water table time derivative for a single hydraulic cell
+    /*!
+    Requires Kint and qH for every thermal column, so all tiles must finish ode_column() first.
+    \param[in] r row of the cell
+    \param[in] j horizontal index of the cell
+    */
+    void ode_cell (long r, long j);
+
     //!evaluates time derivatives as the ODE solver sees them
     /*!
+    Starts a parallel region for the evaluation, unless a persistent team is calling it collectively.
     \param[in] solin current solution array
     \param[out] fout evaluated time derivatives
     */
     void ode_fun (double *solin, double *fout);
 
+    //!evaluates time derivatives with the current team of threads, which must all call it
+    /*!
+    \param[in] solin current solution array
+    \param[out] fout evaluated time derivatives
+    */
+    void ode_fun_team (double *solin, double *fout);
+
+    //!whether a persistent team is running the time loop and evaluates the ode function collectively
+    bool team;
+
     //!updates the evaporation arrays after a step
     void update_evaporation ();
 
@@ -237,4 +828,13 @@ directory, constructs the model, and returns it.
 */
 BousThermModel init_model (std::string &griddir, Settings *stg, const char *dirout);
 
+//!creates a BousThermModel object on the heap, like init_model()
+/*!
+For drivers that need several models at once. The model's threads are the current maximum number of OpenMP threads.
+\param[in] griddir path to directory with grid files
+\param[in] stg Settings structure
+\param[in] dirout path to output directory
+*/
+BousThermModel *new_model (std::string &griddir, Settings *stg, const char *dirout);
+
 #endif
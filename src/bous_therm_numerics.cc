@@ -4,7 +4,233 @@
 
 BousThermNumerics::BousThermNumerics (const std::string &griddir_, long neq_) :
     BousThermGrid (griddir_),  //inherit grid variables
-    OdeTrapz (neq_) {} //inherit ode solving method
+    OdeTrapz (neq_) { //inherit ode solving method
+
+    //default to the trapezoidal method
+    integrator = TRAPZ;
+    nrho = 25;
+    rho = 0.0;
+    nstage = 0;
+    reset_stage_counts();
+    //work arrays are allocated on the first step
+    w0_ = NULL;
+    w1_ = NULL;
+    w2_ = NULL;
+    w3_ = NULL;
+    w4_ = NULL;
+    ev_ = NULL;
+    have_ev_ = false;
+    nsince_rho_ = 0;
+    hlast_ = 0.0;
+}
+
+BousThermNumerics::~BousThermNumerics () {
+    frei(w0_);
+    frei(w1_);
+    frei(w2_);
+    frei(w3_);
+    frei(w4_);
+    frei(ev_);
+}
+
+//------------------------------------------------------------------------------
+//time stepping
+
+void BousThermNumerics::alloc_work () {
+    if (w0_ != NULL) return;
+    w0_ = new double[neq_];
+    w1_ = new double[neq_];
+    w2_ = new double[neq_];
+    w3_ = new double[neq_];
+    w4_ = new double[neq_];
+    ev_ = new double[neq_];
+}
+
+void BousThermNumerics::reset_stage_counts () {
+    nstage_min = 0;
+    nstage_max = 0;
+    nstage_sum = 0;
+    nstage_steps = 0;
+}
+
+void BousThermNumerics::reset_integrator () {
+    rho = 0.0;
+    nstage = 0;
+    reset_stage_counts();
+    have_ev_ = false;
+    nsince_rho_ = 0;
+}
+
+void BousThermNumerics::step_ (double dt) {
+    advance(dt);
+}
+
+void BousThermNumerics::advance (double dt) {
+    #pragma omp single
+    {
+        alloc_work();
+        hlast_ = dt;
+    }
+    if (integrator == RKC) step_rkc(dt);
+    else if (integrator == LTS) step_local(dt);
+    else if (integrator == ETD) step_exponential(dt);
+    else step_trapz(dt);
+}
+
+void BousThermNumerics::eval (double *solin, double *fout) {
+    ode_fun(solin, fout);
+    #pragma omp master
+    neval_++;
+}
+
+void BousThermNumerics::step_trapz (double dt) {
+
+    double *k1 = w0_, *k2 = w1_, *soltemp = w2_;
+
+    //the loops are orphaned worksharing, shared by a team if there is one
+    //slope at the beginning of the step
+    eval(sol_, k1);
+    //forward Euler predictor
+    #pragma omp for schedule(static)
+    for (unsigned long i=0; i<neq_; i++) soltemp[i] = sol_[i] + dt*k1[i];
+    //slope at the end of the step
+    eval(soltemp, k2);
+    //average the slopes
+    #pragma omp for schedule(static)
+    for (unsigned long i=0; i<neq_; i++) sol_[i] = sol_[i] + dt*(k1[i] + k2[i])/2;
+}
+
+double BousThermNumerics::dense_increment (double theta, unsigned long i) {
+    double *k1 = w0_, *k2 = w1_;
+    return( theta*hlast_*(k1[i] + theta*(k2[i] - k1[i])/2) );
+}
+
+double BousThermNumerics::spectral_radius (double *f0) {
+
+    unsigned long i;
+    double *v = w3_, *fv = w4_;
+    //norms
+    double ynrm = 0.0, vnrm = 0.0;
+
+    //start from the previous eigenvector, or from the ode function
+    if (!have_ev_)
+        for (i=0; i<neq_; i++) ev_[i] = f0[i];
+    for (i=0; i<neq_; i++) {
+        ynrm += sol_[i]*sol_[i];
+        vnrm += ev_[i]*ev_[i];
+    }
+    ynrm = sqrt(ynrm);
+    vnrm = sqrt(vnrm);
+    //size of the perturbation
+    double dynrm = (ynrm > 0.0 ? ynrm : 1.0)*sqrt(2.2e-16);
+    if (vnrm > 0.0) {
+        for (i=0; i<neq_; i++) v[i] = sol_[i] + ev_[i]*(dynrm/vnrm);
+    } else {
+        //no direction to start from, perturb every component a little
+        for (i=0; i<neq_; i++) v[i] = sol_[i] + dynrm/sqrt(double(neq_));
+    }
+
+    //power iteration on the differences of the ode function
+    double sigma = 0.0, sigmal;
+    for (int iter=0; iter<20; iter++) {
+        ode_fun_(v, fv);
+        double dfnrm = 0.0;
+        for (i=0; i<neq_; i++) dfnrm += (fv[i] - f0[i])*(fv[i] - f0[i]);
+        dfnrm = sqrt(dfnrm);
+        sigmal = sigma;
+        sigma = dfnrm/dynrm;
+        //converged to within one percent
+        if ( (iter > 0) && (fabs(sigma - sigmal) <= 0.01*sigma) ) break;
+        //next direction
+        if (dfnrm > 0.0) {
+            for (i=0; i<neq_; i++) v[i] = sol_[i] + (fv[i] - f0[i])*(dynrm/dfnrm);
+        } else {
+            break;
+        }
+    }
+    //keep the direction for the next estimate
+    for (i=0; i<neq_; i++) ev_[i] = v[i] - sol_[i];
+    have_ev_ = true;
+
+    //safety factor, since the estimate is from below
+    return( 1.2*sigma );
+}
+
+void BousThermNumerics::step_rkc (double dt) {
+
+    unsigned long i;
+    //ode function at the beginning of the step
+    double *f0 = w0_;
+    ode_fun_(sol_, f0);
+
+    //refresh the spectral radius periodically
+    if ( (rho <= 0.0) || (nsince_rho_ >= nrho) ) {
+        rho = spectral_radius(f0);
+        nsince_rho_ = 0;
+    }
+    nsince_rho_++;
+
+    //number of stages needed for stability, at least two
+    long s = 1 + long(sqrt(1.0 + 1.54*dt*rho));
+    if (s < 2) s = 2;
+    nstage = s;
+    if ( (nstage_steps == 0) || (s < nstage_min) ) nstage_min = s;
+    if (s > nstage_max) nstage_max = s;
+    nstage_sum += s;
+    nstage_steps++;
+
+    //Chebyshev polynomial values and derivatives at w0, with damping
+    double w0 = 1.0 + (2.0/13.0)/double(s*s);
+    double temp1 = w0*w0 - 1.0;
+    double temp2 = sqrt(temp1);
+    double arg = double(s)*log(w0 + temp2);
+    double w1 = sinh(arg)*temp1/(cosh(arg)*double(s)*temp2 - w0*sinh(arg));
+    double bjm1 = 1.0/pow(2.0*w0, 2);
+    double bjm2 = bjm1;
+
+    //first stage, the stages are kept as increments from the solution so a
+    //state that doesn't change stays exactly the same
+    double *djm1 = w1_, *djm2 = w2_, *dj = w3_, *fj = w4_;
+    double mus = w1*bjm1;
+    for (i=0; i<neq_; i++) {
+        djm2[i] = 0.0;
+        djm1[i] = dt*mus*f0[i];
+    }
+
+    //Chebyshev recurrences for the remaining stages
+    double zjm1 = w0, zjm2 = 1.0, dzjm1 = 1.0, dzjm2 = 0.0, d2zjm1 = 0.0, d2zjm2 = 0.0;
+    for (long j=2; j<=s; j++) {
+        double zj = 2.0*w0*zjm1 - zjm2;
+        double dzj = 2.0*w0*dzjm1 - dzjm2 + 2.0*zjm1;
+        double d2zj = 2.0*w0*d2zjm1 - d2zjm2 + 4.0*dzjm1;
+        double bj = d2zj/(dzj*dzj);
+        double ajm1 = 1.0 - zjm1*bjm1;
+        double mu = 2.0*w0*bj/bjm1;
+        double nu = -bj/bjm2;
+        mus = mu*w1/w0;
+        //stage, with the state of the previous stage in the new one's space
+        for (i=0; i<neq_; i++) dj[i] = sol_[i] + djm1[i];
+        ode_fun_(dj, fj);
+        for (i=0; i<neq_; i++)
+            dj[i] = mu*djm1[i] + nu*djm2[i] + dt*mus*(fj[i] - ajm1*f0[i]);
+        //shift the stages
+        double *tmp = djm2;
+        djm2 = djm1;
+        djm1 = dj;
+        dj = tmp;
+        zjm2 = zjm1;
+        zjm1 = zj;
+        dzjm2 = dzjm1;
+        dzjm1 = dzj;
+        d2zjm2 = d2zjm1;
+        d2zjm1 = d2zj;
+        bjm2 = bjm1;
+        bjm1 = bj;
+    }
+
+    //the last stage is the new solution
+    for (i=0; i<neq_; i++) sol_[i] += djm1[i];
+}
 
 double BousThermNumerics::f_linfind (double xa, double ya, double xb, double yb, double y) {
     return( (y - ya)*(xa - xb)/(ya - yb) + xa );
@@ -29,6 +255,72 @@ double BousThermNumerics::f_aquifer_bottom (double *Tin, double Tsurf) {
     return (zdepth);
 }
 
+void BousThermNumerics::tridiag (long n, double *a, double *b, double *c, double *d, double *x, double *w) {
+
+    //forward elimination, w holds the modified super-diagonal
+    double m = b[0];
+    w[0] = c[0]/m;
+    x[0] = d[0]/m;
+    for (long i=1; i<n; i++) {
+        m = b[i] - a[i]*w[i-1];
+        w[i] = c[i]/m;
+        x[i] = (d[i] - a[i]*x[i-1])/m;
+    }
+    //back substitution
+    for (long i=n-2; i>=0; i--)
+        x[i] -= w[i]*x[i+1];
+}
+
+//poles and residues of the degree 14 Chebyshev rational approximation of exp
+//on the negative real axis, exp(x) ~ sum of Re(alpha/(-x - theta)), one of
+//each conjugate pair
+static const double etd_alpha[7][2] = {
+    { 0.557503973136501826E+02, -0.204295038779771857E+03},
+    {-0.938666838877006739E+02,  0.912874896775456363E+02},
+    { 0.469965415550370835E+02, -0.116167609985818103E+02},
+    {-0.961424200626061065E+01, -0.264195613880262669E+01},
+    { 0.752722063978321642E+00,  0.670367365566377770E+00},
+    {-0.188781253158648576E-01, -0.343696176445802414E-01},
+    { 0.143086431411801849E-03,  0.287221133228814096E-03}
+};
+static const double etd_theta[7][2] = {
+    {-0.562314417475317895E+01,  0.119406921611247440E+01},
+    {-0.508934679728216110E+01,  0.358882439228376881E+01},
+    {-0.399337136365302569E+01,  0.600483209099604664E+01},
+    {-0.226978543095856366E+01,  0.846173881758693369E+01},
+    { 0.208756929753827868E+00,  0.109912615662209418E+02},
+    { 0.370327340957595652E+01,  0.136563731924991884E+02},
+    { 0.889777151877331107E+01,  0.166309842834712071E+02}
+};
+
+void BousThermNumerics::phi_matvec (long n, double *a, double *b, double *c, double h, double *v, int p, double *out, std::complex<double> *w) {
+
+    typedef std::complex<double> cplx;
+    cplx *x = w + n;
+    for (long i=0; i<n; i++) out[i] = 0.0;
+    for (int q=0; q<7; q++) {
+        cplx alpha(etd_alpha[q][0], etd_alpha[q][1]);
+        cplx theta(etd_theta[q][0], etd_theta[q][1]);
+        //weight of the pole for phi1 or phi2, from the partial fractions of
+        //(r(z) - 1)/z and (r(z) - 1 - z)/z^2
+        cplx g = (p == 1) ? alpha/theta : -alpha/(theta*theta);
+        //solve (h*A + theta*I) x = v with the Thomas algorithm
+        cplx m = h*b[0] + theta;
+        w[0] = h*c[0]/m;
+        x[0] = v[0]/m;
+        for (long i=1; i<n; i++) {
+            m = h*b[i] + theta - h*a[i]*w[i-1];
+            w[i] = h*c[i]/m;
+            x[i] = (v[i] - h*a[i]*x[i-1])/m;
+        }
+        for (long i=n-2; i>=0; i--)
+            x[i] -= w[i]*x[i+1];
+        //accumulate the real part
+        for (long i=0; i<n; i++)
+            out[i] += std::real(g*x[i]);
+    }
+}
+
 long BousThermNumerics::point_inside (double *edges, double pt, long nedge) {
 
     //point below range
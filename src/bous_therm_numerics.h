@@ -6,6 +6,7 @@
 #include <iostream>
 #include <string>
 #include <cmath>
+#include <complex>
 
 #include "bous_therm_param.h"
 #include "bous_therm_util.h"
@@ -14,12 +15,27 @@
 /* explicit, single-step ODE solver */
 #include "ode_trapz.h"
 
+//------------------------------------------------------------------------------
+//integration methods
+
+//!time stepping methods implemented by BousThermNumerics
+enum Integrator {
+    //!explicit trapezoidal method (Heun's method), two evaluations per step
+    TRAPZ,
+    //!second order Runge-Kutta-Chebyshev method with as many stages as stability requires
+    RKC,
+    //!local time stepping, each thermal column substeps on its own between exchanges of groundwater flux, implemented by the model
+    LTS,
+    //!second order exponential time differencing, with the linear conduction operator of each column integrated exactly, implemented by the model
+    ETD
+};
+
 //------------------------------------------------------------------------------
 //model class
 
 //!Inherits from the BousThermGrid class and an ODE integrating class from libode
 /*!
-Implements some of the numerical functions needed for evaluating the spatial discretization
+Implements some of the numerical functions needed for evaluating the spatial discretization, and the time stepping methods. The explicit trapezoidal method matches the libode OdeTrapz method. The Runge-Kutta-Chebyshev (RKC) method is a stabilized explicit method for parabolic problems, whose stability region along the negative real axis grows with the square of the number of stages. The number of stages is chosen every step from an estimate of the spectral radius of the Jacobian, found by nonlinear power iteration with the ode function only, so the method stays matrix free. Local time stepping and exponential time differencing are implemented by the model, which knows the structure of the thermal columns.
 */
 class BousThermNumerics : public BousThermGrid, public OdeTrapz {
 
@@ -31,6 +47,68 @@ public:
     \param[in] neq_ size of ODE system
     */
     BousThermNumerics (const std::string &griddir_, long neq_);
+    //!destructs
+    ~BousThermNumerics ();
+
+    //--------------------------------------------------------------------------
+    //time stepping
+
+    //!method used for each step
+    Integrator integrator;
+    //!number of steps between spectral radius estimates for the RKC method
+    long nrho;
+    //!current estimate of the spectral radius of the Jacobian (1/s)
+    double rho;
+    //!number of RKC stages in the last step
+    long nstage;
+    //!fewest RKC stages since the counters were reset
+    long nstage_min;
+    //!most RKC stages since the counters were reset
+    long nstage_max;
+    //!total RKC stages since the counters were reset
+    long nstage_sum;
+    //!number of RKC steps since the counters were reset
+    long nstage_steps;
+
+    //!resets the RKC stage counters
+    void reset_stage_counts ();
+
+    //!forgets the spectral radius estimate and the stage counters, so the next step starts like the first
+    void reset_integrator ();
+
+    //!advances the solution by one step with the selected method, without updating the time or step count
+    /*!
+    The trapezoidal method may be called by every thread of a parallel region at once, in which case its vector updates are shared among the threads and the ode function must be evaluated collectively by the team. The RKC method, local time stepping, and exponential time differencing must be called from a single thread.
+    \param[in] dt time step
+    */
+    void advance (double dt);
+
+    //!advances the solution by one step with local time stepping, implemented by the model
+    /*!
+    \param[in] dt time step, the interval between exchanges of groundwater flux
+    */
+    virtual void step_local (double dt) = 0;
+
+    //!advances the solution by one step with exponential time differencing, implemented by the model
+    /*!
+    \param[in] dt time step
+    */
+    virtual void step_exponential (double dt) = 0;
+
+    //!change of a solution component over part of the last step, from the continuous extension of the trapezoidal method
+    /*!
+    The explicit trapezoidal method has the continuous extension u(t + theta*h) = u(t) + theta*h*(k1 + theta*(k2 - k1)/2), with the slopes k1 and k2 of its two stages, which is second order accurate and matches the step at theta = 1. Only valid after a trapezoidal step, until the next one.
+    \param[in] theta fraction of the step
+    \param[in] i index of the component
+    */
+    double dense_increment (double theta, unsigned long i);
+
+    //!estimates the spectral radius of the Jacobian at the current solution by nonlinear power iteration
+    /*!
+    \param[in] f0 ode function evaluated at the current solution
+    \return estimated spectral radius (1/s), with a safety factor
+    */
+    double spectral_radius (double *f0);
 
     //!finds a point on a line, given two points and the value to locate
     /*!
@@ -57,6 +135,66 @@ public:
     \param[in] nedge length of the edges array
     */
     long point_inside (double *edges, double pt, long nedge);
+
+    //!solves a tridiagonal system with the Thomas algorithm
+    /*!
+    Row i of the system is a[i]*x[i-1] + b[i]*x[i] + c[i]*x[i+1] = d[i], with a[0] and c[n-1] ignored. The matrix must be diagonally dominant, which is true for implicit diffusion, so no pivoting is done.
+    \param[in] n size of the system
+    \param[in] a sub-diagonal
+    \param[in] b diagonal
+    \param[in] c super-diagonal
+    \param[in] d right hand side
+    \param[out] x solution
+    \param[out] w scratch space of length n
+    */
+    void tridiag (long n, double *a, double *b, double *c, double *d, double *x, double *w);
+
+    //!multiplies a vector by the phi function of a tridiagonal matrix with real, nonpositive eigenvalues
+    /*!
+    The phi functions are phi1(z) = (exp(z) - 1)/z and phi2(z) = (exp(z) - 1 - z)/z^2, which are the weights of exponential time differencing. They're evaluated with the partial fraction form of the degree 14 Chebyshev rational approximation of exp on the negative real axis (as in EXPOKIT's chbv), adjusted for the phi functions, so each product costs 7 complex tridiagonal solves and is accurate to about 1e-11 for any step. The matrix must be similar to a symmetric negative semidefinite one, which is true of the conduction operator of a column. Row i of the matrix is a[i], b[i], c[i] on the sub-diagonal, diagonal, and super-diagonal.
+    \param[in] n size of the system
+    \param[in] a sub-diagonal
+    \param[in] b diagonal
+    \param[in] c super-diagonal
+    \param[in] h time step multiplying the matrix
+    \param[in] v vector to multiply
+    \param[in] p which phi function, 1 or 2
+    \param[out] out the product
+    \param[out] w complex scratch space of length 2n
+    */
+    void phi_matvec (long n, double *a, double *b, double *c, double h, double *v, int p, double *out, std::complex<double> *w);
+
+private:
+
+    //!work arrays for the integrators
+    double *w0_, *w1_, *w2_, *w3_, *w4_;
+    //!eigenvector estimate from the last power iteration
+    double *ev_;
+    //!whether ev_ holds a previous estimate
+    bool have_ev_;
+    //!number of steps taken since the last spectral radius estimate
+    long nsince_rho_;
+    //!size of the last step
+    double hlast_;
+
+    //!allocates the work arrays on first use
+    void alloc_work ();
+
+    //!advances the solution with the selected method
+    /*!
+    Overrides the step of the libode base class, so that every solve uses the selected method.
+    \param[in] dt time step
+    */
+    void step_ (double dt);
+
+    //!evaluates the ode function and counts the evaluation once, even if called by a whole team
+    void eval (double *solin, double *fout);
+
+    //!advances the solution with the explicit trapezoidal method
+    void step_trapz (double dt);
+
+    //!advances the solution with the RKC method
+    void step_rkc (double dt);
 };
 
 
@@ -29,6 +29,39 @@ double f_captherm (double poro, double temp, double wsat, double isat) {
     return(cap);
 }
 
+double f_enthalpy (double poro, double temp, double sat, double lfrac) {
+
+    //sensible capacity of the rock
+    double capr = (1.0 - poro)*RHO_R*C_R;
+    //frozen, thawed, or in between
+    if (temp < TFREEZE)
+        return( (capr + poro*sat*RHO_W*C_I)*(temp - TFREEZE) );
+    if (temp > TFREEZE)
+        return( poro*sat*RHO_W*LF_W + (capr + poro*sat*RHO_W*C_W)*(temp - TFREEZE) );
+    return( poro*sat*RHO_W*LF_W*lfrac );
+}
+
+double f_enthalpy_temp (double poro, double enth, double sat, double *lfrac) {
+
+    //sensible capacity of the rock
+    double capr = (1.0 - poro)*RHO_R*C_R;
+    //latent heat of the pore water
+    double lat = poro*sat*RHO_W*LF_W;
+    //frozen
+    if (enth <= 0.0) {
+        *lfrac = 0.0;
+        return( TFREEZE + enth/(capr + poro*sat*RHO_W*C_I) );
+    }
+    //thawed
+    if (enth >= lat) {
+        *lfrac = 1.0;
+        return( TFREEZE + (enth - lat)/(capr + poro*sat*RHO_W*C_W) );
+    }
+    //changing phase at the freezing point
+    *lfrac = enth/lat;
+    return( TFREEZE );
+}
+
 //-----------------------------------
 //time dependent parameters
 
@@ -64,6 +64,25 @@ double f_ktherm (double poro, double kTr);
 //!thermal capacity (J/m^3*K)
 double f_captherm (double poro, double temp, double wsat, double isat);
 
+//!volumetric enthalpy (J/m^3) relative to ice at the freezing point
+/*!
+\param[in] poro porosity
+\param[in] temp temperature (K)
+\param[in] sat fraction of the pore space filled with water or ice
+\param[in] lfrac liquid fraction of the pore water, only used at the freezing point
+*/
+double f_enthalpy (double poro, double temp, double sat, double lfrac);
+
+//!inverts the volumetric enthalpy for temperature (K) and liquid fraction
+/*!
+The phase change happens at the freezing point, so enthalpy between zero and the latent heat of the pore water leaves the temperature at TFREEZE and sets the liquid fraction.
+\param[in] poro porosity
+\param[in] enth volumetric enthalpy (J/m^3) relative to ice at the freezing point
+\param[in] sat fraction of the pore space filled with water or ice
+\param[out] lfrac liquid fraction of the pore water
+*/
+double f_enthalpy_temp (double poro, double enth, double sat, double *lfrac);
+
 //-----------------------------------
 //time dependent parameters
 
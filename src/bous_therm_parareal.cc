@@ -0,0 +1,174 @@
+//! \file bous_therm_parareal.cc
+
+#include "bous_therm_parareal.h"
+
+//largest differences between two states, in the water table and thermal parts
+static void state_diff (double *a, double *b, long Ncell, unsigned long neq, double *dH, double *dT) {
+    for (long i=0; i<Ncell; i++) *dH = std::max(*dH, fabs(a[i] - b[i]));
+    for (unsigned long i=Ncell; i<neq; i++) *dT = std::max(*dT, fabs(a[i] - b[i]));
+}
+
+void solve_parareal (std::string &griddir, Settings *stg, const char *dirout) {
+
+    //--------------------------------------------------------------------------
+    //slices and thread groups
+
+    long N = stg->nslice;
+    double tint = stg->tend*stg->tunit;
+    long nfine = std::max(1L, long(stg->nstep)/N);
+    long niter = (stg->npara > 0) ? std::min(stg->npara, N) : N;
+    //the thermal tolerance is in K, with the enthalpy formulation it's the
+    //enthalpy of that much warming of rock
+    double tolT = stg->enthalpy ? stg->tolparaT*RHO_R*C_R : stg->tolparaT;
+    //slice boundaries
+    std::vector<double> ts(N+1);
+    for (long n=0; n<=N; n++) ts[n] = tint*double(n)/double(N);
+    //the threads are split into groups, each running whole slices
+    int nthr = omp_get_max_threads();
+    int ngroup = int(std::min(long(nthr), N));
+    int gthr = std::max(1, nthr/ngroup);
+    omp_set_max_active_levels(2);
+
+    //--------------------------------------------------------------------------
+    //models
+
+    //the coarse propagator uses every thread and writes the output
+    Settings cstg = *stg;
+    cstg.integrator = stg->coarse;
+    BousThermModel *G = new_model(griddir, &cstg, dirout);
+    unsigned long neq = G->get_neq();
+    long Ncell = G->Ncell;
+    //the serial fine solution uses every thread too
+    BousThermModel *R = NULL;
+    if (stg->pararef) R = new_model(griddir, stg, dirout);
+    //a fine propagator for each slice, each with the threads of a group
+    omp_set_num_threads(gthr);
+    std::vector<BousThermModel*> F(N);
+    for (long n=0; n<N; n++) F[n] = new_model(griddir, stg, dirout);
+    omp_set_num_threads(nthr);
+
+    printf("\nparareal integration over %g yr in %li slices, %li fine and %li coarse (%s) steps per slice\n",
+        tint/YEAR_SEC, N, nfine, stg->ncoarse, stg->coarse.c_str());
+    printf("%d groups of %d threads run the fine propagators\n", ngroup, gthr);
+
+    //--------------------------------------------------------------------------
+    //states at the slice boundaries
+
+    std::vector<double*> U(N+1), Uo(N+1), Go(N+1), Fo(N+1), Ur;
+    double *g = new double[neq];
+    for (long n=0; n<=N; n++) {
+        U[n] = new double[neq];
+        Uo[n] = new double[neq];
+        Go[n] = new double[neq];
+        Fo[n] = new double[neq];
+    }
+    //the initial state is the same in every model
+    double *u0 = G->get_sol();
+    for (unsigned long i=0; i<neq; i++) U[0][i] = u0[i];
+    G->before_solve();
+
+    //serial fine solution for reference
+    if (stg->pararef) {
+        Ur.resize(N+1);
+        for (long n=0; n<=N; n++) Ur[n] = new double[neq];
+        for (unsigned long i=0; i<neq; i++) Ur[0][i] = U[0][i];
+        double tic = omp_get_wtime();
+        for (long n=0; n<N; n++)
+            R->propagate(Ur[n], ts[n], ts[n+1], nfine, Ur[n+1]);
+        printf("serial fine solution took %g sec\n", omp_get_wtime() - tic);
+    }
+
+    //coarse prediction
+    double tic = omp_get_wtime();
+    for (long n=0; n<N; n++) {
+        G->propagate(U[n], ts[n], ts[n+1], stg->ncoarse, Go[n+1]);
+        for (unsigned long i=0; i<neq; i++) U[n+1][i] = Go[n+1][i];
+    }
+    printf("coarse prediction took %g sec\n", omp_get_wtime() - tic);
+
+    //--------------------------------------------------------------------------
+    //iterations
+
+    long k;
+    for (k=1; k<=niter; k++) {
+        tic = omp_get_wtime();
+        //slices before k-1 start from converged states and are done, the
+        //states of the others are kept for comparison
+        for (long n=k-1; n<=N; n++)
+            for (unsigned long i=0; i<neq; i++) Uo[n][i] = U[n][i];
+
+        //fine propagation of the remaining slices, all at once
+        #pragma omp parallel for schedule(dynamic) num_threads(ngroup)
+        for (long n=k-1; n<N; n++)
+            F[n]->propagate(Uo[n], ts[n], ts[n+1], nfine, Fo[n+1]);
+
+        //coarse sweep from the new states, with the correction
+        for (long n=k-1; n<N; n++) {
+            G->propagate(U[n], ts[n], ts[n+1], stg->ncoarse, g);
+            for (unsigned long i=0; i<neq; i++) {
+                U[n+1][i] = g[i] + Fo[n+1][i] - Go[n+1][i];
+                Go[n+1][i] = g[i];
+            }
+        }
+        double dH = 0.0, dT = 0.0;
+        for (long n=k; n<=N; n++) state_diff(U[n], Uo[n], Ncell, neq, &dH, &dT);
+
+        //report
+        printf("  iteration %2li: largest change %.2e m (water table), %.2e (thermal)", k, dH, dT);
+        if (stg->pararef) {
+            double eH = 0.0, eT = 0.0;
+            for (long n=1; n<=N; n++) state_diff(U[n], Ur[n], Ncell, neq, &eH, &eT);
+            printf(", error %.2e m, %.2e", eH, eT);
+        }
+        printf(", %g sec\n", omp_get_wtime() - tic);
+        if ( (dH <= stg->tolparaH) && (dT <= tolT) ) break;
+    }
+    if (k > niter) k = niter;
+    printf("parareal finished after %li iterations\n\n", k);
+
+    //--------------------------------------------------------------------------
+    //output from the coarse model
+
+    //snap the state at the end of each slice, with the evaporation of the
+    //fine propagator and the cumulative evaporation of all slices so far
+    for (long c=0; c<Ncell; c++) G->cumevap[c] = 0.0;
+    for (long n=0; n<N; n++) {
+        for (long c=0; c<Ncell; c++) {
+            G->evap[c] = F[n]->evap[c];
+            G->evapw[c] = F[n]->evapw[c];
+            G->cumevap[c] += F[n]->cumevap[c];
+        }
+        G->set_sol(U[n+1]);
+        G->set_t(ts[n+1]);
+        G->snap(dirout, n, ts[n+1]);
+    }
+    //join the output vectors of the fine sweeps
+    G->o_t.clear();
+    G->o_evap.clear();
+    G->o_evapw.clear();
+    G->o_maxaqbot.clear();
+    G->o_minaqbot.clear();
+    for (long n=0; n<N; n++) {
+        G->o_t.insert(G->o_t.end(), F[n]->o_t.begin(), F[n]->o_t.end());
+        G->o_evap.insert(G->o_evap.end(), F[n]->o_evap.begin(), F[n]->o_evap.end());
+        G->o_evapw.insert(G->o_evapw.end(), F[n]->o_evapw.begin(), F[n]->o_evapw.end());
+        G->o_maxaqbot.insert(G->o_maxaqbot.end(), F[n]->o_maxaqbot.begin(), F[n]->o_maxaqbot.end());
+        G->o_minaqbot.insert(G->o_minaqbot.end(), F[n]->o_minaqbot.begin(), F[n]->o_minaqbot.end());
+    }
+    G->after_solve();
+
+    //--------------------------------------------------------------------------
+    //clean up
+
+    for (long n=0; n<=N; n++) {
+        delete [] U[n];
+        delete [] Uo[n];
+        delete [] Go[n];
+        delete [] Fo[n];
+        if (stg->pararef) delete [] Ur[n];
+    }
+    delete [] g;
+    for (long n=0; n<N; n++) delete F[n];
+    if (R != NULL) delete R;
+    delete G;
+}
@@ -0,0 +1,31 @@
+#ifndef BOUS_THERM_PARAREAL_H_
+#define BOUS_THERM_PARAREAL_H_
+
+//! \file bous_therm_parareal.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "omp.h"
+
+#include "bous_therm_settings.h"
+#include "bous_therm_model.h"
+
+//!integrates a trial with the parareal algorithm, running time slices at once on separate groups of threads
+/*!
+The integration is split into `nslice` equal time slices. A coarse propagator, a model using the `coarse` integrator with `ncoarse` steps per slice, sweeps through the slices serially to predict the state at the start of each. Then every iteration runs the fine propagator, a model using the usual integrator with `nstep/nslice` steps per slice, on all the slices that haven't converged at once. Each slice has its own model, and the slices are shared among groups of threads, each group running its slices with its own threads. The coarse propagator sweeps again from the corrected states, and the state at the start of slice n+1 becomes
+
+    U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n])
+
+where F and G are the fine and coarse propagators. After k iterations the first k slices match the serial fine solution exactly, so at most `nslice` iterations reproduce it, but on smooth forcing like the surface temperature ramp the iterations converge much sooner. Iterations stop when the water table at the slice ends changes by less than `tolparaH` and the thermal state by less than `tolparaT`, or after `npara` iterations. The largest change of the water table and of the thermal state are reported at each iteration, along with the error against the serial fine solution if `pararef` is set.
+
+The coarse model writes the output: a snap at the end of each slice, with the evaporation of the last fine sweep, and the output vectors of the fine sweep, joined across the slices.
+\param[in] griddir path to the grid directory
+\param[in] stg settings
+\param[in] dirout path to the output directory
+*/
+void solve_parareal (std::string &griddir, Settings *stg, const char *dirout);
+
+#endif
@@ -0,0 +1,108 @@
+//! \file bous_therm_sequence.cc
+
+#include "bous_therm_sequence.h"
+
+void sequence_grid (BousThermModel &mod, std::string &griddir, Settings *stg, const std::string &dirout) {
+
+    //--------------------------------------------------------------------------
+    //coarse grid and model
+
+    std::string dirc = dirout + "/coarse_grid";
+    coarsen_grid(griddir, dirc, stg->seqx, stg->seqz);
+    BousThermModel *C = new_model(dirc, stg, dirc.c_str());
+    unsigned long neq = C->get_neq();
+    long Ncell = C->Ncell;
+
+    //the coarse porosity is the mean of the fine porosity in each cell, so the
+    //columns of both grids hold the same water when they leave the same empty
+    //pore space (see BousThermModel::prolong())
+    std::vector<double> pv(C->Nz, 0.0);
+    for (long i=0; i<mod.Nz; i++)
+        pv[mod.point_inside(C->ze, mod.zc[i], C->Nz+1)] += mod.delz[i]*mod.poro[i];
+    for (long I=0; I<C->Nz; I++) C->poro[I] = pv[I]/C->delz[I];
+    //the initial enthalpy depends on the porosity
+    if (stg->enthalpy) {
+        for (long k=0; k<C->Ncol; k++)
+            for (long I=0; I<C->Nz; I++)
+                C->T[k][I] = C->temp[k][I];
+        for (long r=0; r<C->Ny; r++)
+            for (long j=0; j<=C->Nx; j++)
+                C->init_enthalpy(r, j);
+    }
+
+    //switch time and coarse steps
+    double tend = stg->tend*stg->tunit;
+    double tseq = std::min(stg->tseq*stg->tunit, tend);
+    long f = std::min(stg->seqx, stg->seqz);
+    double dtc = f*f*tend/double(stg->nstep);
+    long npart = (stg->tolseq > 0.0) ? 10 : 1;
+    printf("\nrunning the first %g yr on a grid of %li x %li cells with %g sec steps\n",
+        tseq/YEAR_SEC, C->Nx, C->Nz, dtc);
+
+    //--------------------------------------------------------------------------
+    //coarse phase
+
+    double *u0 = new double[neq], *u1 = new double[neq];
+    double *cumevap = new double[Ncell];
+    for (unsigned long i=0; i<neq; i++) u0[i] = C->get_sol()[i];
+    for (long c=0; c<Ncell; c++) cumevap[c] = 0.0;
+    std::vector<double> o_t, o_evap, o_evapw, o_maxaqbot, o_minaqbot;
+    double t = 0.0, tic = omp_get_wtime();
+    long nstepc = 0;
+    for (long n=0; n<npart; n++) {
+        double t1 = tseq*double(n+1)/double(npart);
+        long ns = std::max(1L, long(ceil((t1 - t)/dtc)));
+        C->propagate(u0, t, t1, ns, u1);
+        nstepc += ns;
+        //keep the record of each part
+        o_t.insert(o_t.end(), C->o_t.begin(), C->o_t.end());
+        o_evap.insert(o_evap.end(), C->o_evap.begin(), C->o_evap.end());
+        o_evapw.insert(o_evapw.end(), C->o_evapw.begin(), C->o_evapw.end());
+        o_maxaqbot.insert(o_maxaqbot.end(), C->o_maxaqbot.begin(), C->o_maxaqbot.end());
+        o_minaqbot.insert(o_minaqbot.end(), C->o_minaqbot.begin(), C->o_minaqbot.end());
+        for (long c=0; c<Ncell; c++) cumevap[c] += C->cumevap[c];
+        //largest changes of the water table and thermal state over the part
+        double dH = 0.0, dT = 0.0;
+        for (long i=0; i<Ncell; i++) dH = std::max(dH, fabs(u1[i] - u0[i]));
+        for (unsigned long i=Ncell; i<neq; i++) dT = std::max(dT, fabs(u1[i] - u0[i]));
+        for (unsigned long i=0; i<neq; i++) u0[i] = u1[i];
+        t = t1;
+        if (npart > 1)
+            printf("  %g yr: largest change %.2e m (water table), %.2e (thermal)\n", t/YEAR_SEC, dH, dT);
+        if ( (npart > 1) && (std::max(dH, dT) <= stg->tolseq) ) break;
+    }
+    printf("coarse phase took %li steps and %g sec\n", nstepc, omp_get_wtime() - tic);
+
+    //--------------------------------------------------------------------------
+    //move onto the real grid
+
+    C->set_sol(u0);
+    C->set_t(t);
+    mod.prolong(C);
+    mod.set_t(t);
+    //count steps as if the real grid had taken them, so spin-up states are
+    //saved under the step of their time
+    mod.set_nstep(llround(t/(tend/double(stg->nstep))));
+    mod.o_t = o_t;
+    mod.o_evap = o_evap;
+    mod.o_evapw = o_evapw;
+    mod.o_maxaqbot = o_maxaqbot;
+    mod.o_minaqbot = o_minaqbot;
+    //cumulative evaporation is a volume, spread over the fine cells by width
+    for (long r=0; r<mod.Ny; r++) {
+        for (long j=0; j<mod.Nx; j++) {
+            long J = mod.point_inside(C->xe, mod.xc[j], C->Nx+1);
+            long c = r*mod.Nx + j;
+            mod.cumevap[c] = cumevap[r*C->Nx + J]*mod.delx[j]/C->delx[J];
+            mod.evap[c] = 0.0;
+            mod.evapw[c] = 0.0;
+        }
+    }
+    mod.resumed = true;
+    printf("switching to the real grid at %g yr\n\n", t/YEAR_SEC);
+
+    delete [] u0;
+    delete [] u1;
+    delete [] cumevap;
+    delete C;
+}
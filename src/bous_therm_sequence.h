@@ -0,0 +1,25 @@
+#ifndef BOUS_THERM_SEQUENCE_H_
+#define BOUS_THERM_SEQUENCE_H_
+
+//! \file bous_therm_sequence.h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "bous_therm_settings.h"
+#include "bous_therm_gridgen.h"
+#include "bous_therm_model.h"
+
+//!runs the early part of a trial on a coarsened grid and moves the state onto the real grid
+/*!
+The grid is coarsened by coarsen_grid(), merging `seqx` horizontal and `seqz` vertical cells, into the `coarse_grid` subdirectory of the output directory. A model on the coarse grid integrates from the usual initial state until `tseq`, in fixed steps that are longer than the trial's steps by the square of the smaller merge factor, because the stability limits of conduction and groundwater flow grow with the square of the cell size. With `tolseq`, the coarse phase is split into ten parts and ends after the first part over which neither the water table nor the thermal state changes by more than `tolseq`. The state is then moved onto the real grid by BousThermModel::prolong(), which keeps the empty pore space above the water table and the heat of the coarse cells, and the pore water too because the coarse porosity is set to the mean of the fine porosity, along with the output vectors of the coarse phase and its cumulative evaporation, spread over the fine cells by width, so the model can carry on from the switch time.
+\param[in,out] mod model on the real grid
+\param[in] griddir path to the real grid directory
+\param[in] stg settings
+\param[in] dirout path to the output directory
+*/
+void sequence_grid (BousThermModel &mod, std::string &griddir, Settings *stg, const std::string &dirout);
+
+#endif
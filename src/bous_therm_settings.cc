@@ -17,11 +17,78 @@ long to_long(const char *val) {
     return( long(std::atof(val)) );
 }
 
+bool in_list (const std::string &list, const char *name) {
+    if (list == "all") return(true);
+    //check each comma separated item
+    std::string item;
+    size_t i0 = 0, i1;
+    while (i0 <= list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        item = list.substr(i0, i1 - i0);
+        //ignore spaces around names
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        if (item == name) return(true);
+        i0 = i1 + 1;
+    }
+    return(false);
+}
+
 Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
 
     Settings s;
     const char *set, *val;
 
+    //optional settings have defaults
+    s.integrator = "trapz";
+    s.nrho    = 25;
+    s.autodt  = false;
+    s.dtsafe  = 0.8;
+    s.ndt     = 100;
+    s.implicitH = false;
+    s.npicard = 20;
+    s.tolpicard = 1e-6;
+    s.nslice  = 0;
+    s.coarse  = "etd";
+    s.ncoarse = 10;
+    s.npara   = 0;
+    s.tolparaH = 1e-5;
+    s.tolparaT = 0.1;
+    s.pararef = false;
+    s.tilenx  = 0;
+    s.tileny  = 0;
+    s.affinity = false;
+    s.persist = false;
+    s.nrebal  = 0;
+    s.precval = false;
+    s.diagout = "all";
+    s.snapdelta = false;
+    s.deltakey = 0;
+    s.enthalpy = false;
+    s.cache   = "";
+    s.cachelink = false;
+    s.spinup  = "";
+    s.spinsave = "";
+    s.tseq    = 0.0;
+    s.seqx    = 2;
+    s.seqz    = 2;
+    s.tolseq  = 0.0;
+    s.sensitivity = "";
+    s.sensrel = 1e-6;
+    s.calib   = "";
+    s.calibtarget = "";
+    s.calibiter = 100;
+    s.calibtol = 1e-3;
+    s.calibstep = 0.2;
+    s.stats   = false;
+    s.statbins = 20;
+    s.statdmax = 100.0;
+    s.probes  = "";
+    s.probeevery = 1;
+    s.events  = "";
+    s.eventdo = "snap";
+
     for (int i=0; i < int(sv.size()); i++) {
 
         //get the setting and value pair
@@ -35,6 +102,54 @@ Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
         else if ( cmp(set, "tunit") )   s.tunit   = std::atof(val);
         else if ( cmp(set, "nsnap") )   s.nsnap   = to_long(val);
         else if ( cmp(set, "nmaxout") ) s.nmaxout = to_long(val);
+        else if ( cmp(set, "integrator") ) s.integrator = val;
+        else if ( cmp(set, "nrho") )    s.nrho    = to_long(val);
+        else if ( cmp(set, "autodt") )  s.autodt  = std::atoi(val);
+        else if ( cmp(set, "dtsafe") )  s.dtsafe  = std::atof(val);
+        else if ( cmp(set, "ndt") )     s.ndt     = to_long(val);
+        else if ( cmp(set, "implicitH") ) s.implicitH = std::atoi(val);
+        else if ( cmp(set, "npicard") ) s.npicard = to_long(val);
+        else if ( cmp(set, "tolpicard") ) s.tolpicard = std::atof(val);
+        else if ( cmp(set, "nslice") )  s.nslice  = to_long(val);
+        else if ( cmp(set, "coarse") )  s.coarse  = val;
+        else if ( cmp(set, "ncoarse") ) s.ncoarse = to_long(val);
+        else if ( cmp(set, "npara") )   s.npara   = to_long(val);
+        else if ( cmp(set, "tolparaH") ) s.tolparaH = std::atof(val);
+        else if ( cmp(set, "tolparaT") ) s.tolparaT = std::atof(val);
+        else if ( cmp(set, "pararef") ) s.pararef = std::atoi(val);
+
+        else if ( cmp(set, "tilenx") )  s.tilenx  = to_long(val);
+        else if ( cmp(set, "tileny") )  s.tileny  = to_long(val);
+        else if ( cmp(set, "affinity") ) s.affinity = std::atoi(val);
+        else if ( cmp(set, "persist") ) s.persist = std::atoi(val);
+        else if ( cmp(set, "nrebal") )  s.nrebal  = to_long(val);
+        else if ( cmp(set, "precval") ) s.precval = std::atoi(val);
+        else if ( cmp(set, "diagout") ) s.diagout = val;
+        else if ( cmp(set, "snapdelta") ) s.snapdelta = std::atoi(val);
+        else if ( cmp(set, "deltakey") ) s.deltakey = to_long(val);
+        else if ( cmp(set, "enthalpy") ) s.enthalpy = std::atoi(val);
+        else if ( cmp(set, "cache") )   s.cache   = val;
+        else if ( cmp(set, "cachelink") ) s.cachelink = std::atoi(val);
+        else if ( cmp(set, "spinup") )  s.spinup  = val;
+        else if ( cmp(set, "spinsave") ) s.spinsave = val;
+        else if ( cmp(set, "tseq") )    s.tseq    = std::atof(val);
+        else if ( cmp(set, "seqx") )    s.seqx    = to_long(val);
+        else if ( cmp(set, "seqz") )    s.seqz    = to_long(val);
+        else if ( cmp(set, "tolseq") )  s.tolseq  = std::atof(val);
+        else if ( cmp(set, "sensitivity") ) s.sensitivity = val;
+        else if ( cmp(set, "sensrel") ) s.sensrel = std::atof(val);
+        else if ( cmp(set, "calib") )   s.calib   = val;
+        else if ( cmp(set, "calibtarget") ) s.calibtarget = val;
+        else if ( cmp(set, "calibiter") ) s.calibiter = to_long(val);
+        else if ( cmp(set, "calibtol") ) s.calibtol = std::atof(val);
+        else if ( cmp(set, "calibstep") ) s.calibstep = std::atof(val);
+        else if ( cmp(set, "stats") )   s.stats   = std::atoi(val);
+        else if ( cmp(set, "statbins") ) s.statbins = to_long(val);
+        else if ( cmp(set, "statdmax") ) s.statdmax = std::atof(val);
+        else if ( cmp(set, "probes") )  s.probes  = val;
+        else if ( cmp(set, "probeevery") ) s.probeevery = to_long(val);
+        else if ( cmp(set, "events") )  s.events  = val;
+        else if ( cmp(set, "eventdo") ) s.eventdo = val;
 
         else if ( cmp(set, "Hdep0") )   s.Hdep0   = std::atof(val);
         else if ( cmp(set, "Rmax") )    s.Rmax    = std::atoi(val);
@@ -57,3 +172,130 @@ Settings parse_settings ( std::vector< std::vector< std::string > > sv ) {
 
     return(s);
 }
+
+double *physical_param (Settings &s, const std::string &name) {
+    if      (name == "Hdep0")   return(&s.Hdep0);
+    else if (name == "poro0")   return(&s.poro0);
+    else if (name == "porogam") return(&s.porogam);
+    else if (name == "perm0")   return(&s.perm0);
+    else if (name == "permgam") return(&s.permgam);
+    else if (name == "kTr")     return(&s.kTr);
+    else if (name == "fTgeo")   return(&s.fTgeo);
+    else if (name == "Ts0")     return(&s.Ts0);
+    else if (name == "Tsf")     return(&s.Tsf);
+    else if (name == "Tsgam")   return(&s.Tsgam);
+    else if (name == "TsLR")    return(&s.TsLR);
+    return(NULL);
+}
+
+//appends a "name = value" line
+static void canon (std::string &txt, const char *name, double v) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.17g", v);
+    txt += std::string(name) + " = " + buf + "\n";
+}
+
+static void canon (std::string &txt, const char *name, const std::string &v) {
+    txt += std::string(name) + " = " + v + "\n";
+}
+
+std::string canonical_settings (const Settings &s) {
+
+    std::string txt;
+
+    canon(txt, "nstep", double(s.nstep));
+    canon(txt, "tend", s.tend);
+    canon(txt, "tunit", s.tunit);
+    canon(txt, "nsnap", s.nsnap);
+    canon(txt, "nmaxout", double(s.nmaxout));
+    canon(txt, "integrator", s.integrator);
+    canon(txt, "nrho", s.nrho);
+    canon(txt, "autodt", s.autodt);
+    canon(txt, "dtsafe", s.dtsafe);
+    canon(txt, "ndt", s.ndt);
+    canon(txt, "implicitH", s.implicitH);
+    canon(txt, "nslice", s.nslice);
+    canon(txt, "coarse", s.coarse);
+    canon(txt, "ncoarse", s.ncoarse);
+    canon(txt, "npara", s.npara);
+    canon(txt, "tolparaH", s.tolparaH);
+    canon(txt, "tolparaT", s.tolparaT);
+    canon(txt, "pararef", s.pararef);
+    canon(txt, "npicard", s.npicard);
+    canon(txt, "tolpicard", s.tolpicard);
+
+    canon(txt, "diagout", s.diagout);
+    canon(txt, "snapdelta", s.snapdelta);
+    canon(txt, "deltakey", s.deltakey);
+    canon(txt, "enthalpy", s.enthalpy);
+    canon(txt, "spinup", s.spinup);
+    canon(txt, "spinsave", s.spinsave);
+    canon(txt, "tseq", s.tseq);
+    canon(txt, "seqx", s.seqx);
+    canon(txt, "seqz", s.seqz);
+    canon(txt, "tolseq", s.tolseq);
+    canon(txt, "sensitivity", s.sensitivity);
+    canon(txt, "sensrel", s.sensrel);
+    canon(txt, "calib", s.calib);
+    canon(txt, "calibtarget", s.calibtarget);
+    canon(txt, "calibiter", s.calibiter);
+    canon(txt, "calibtol", s.calibtol);
+    canon(txt, "calibstep", s.calibstep);
+    canon(txt, "stats", s.stats);
+    canon(txt, "statbins", s.statbins);
+    canon(txt, "statdmax", s.statdmax);
+    canon(txt, "probes", s.probes);
+    canon(txt, "probeevery", s.probeevery);
+    canon(txt, "events", s.events);
+    canon(txt, "eventdo", s.eventdo);
+
+    canon(txt, "Hdep0", s.Hdep0);
+    canon(txt, "Rmax", s.Rmax);
+    canon(txt, "poro0", s.poro0);
+    canon(txt, "porogam", s.porogam);
+    canon(txt, "perm0", s.perm0);
+    canon(txt, "permgam", s.permgam);
+    canon(txt, "kTr", s.kTr);
+    canon(txt, "fTgeo", s.fTgeo);
+    canon(txt, "Ts0", s.Ts0);
+    canon(txt, "Tsf", s.Tsf);
+    canon(txt, "Tsgam", s.Tsgam);
+    canon(txt, "TsLR", s.TsLR);
+
+    return(txt);
+}
+
+std::string trajectory_settings (const Settings &s) {
+
+    std::string txt;
+
+    canon(txt, "dt", s.tend*s.tunit/double(s.nstep));
+    canon(txt, "integrator", s.integrator);
+    canon(txt, "nrho", s.nrho);
+    canon(txt, "implicitH", s.implicitH);
+    canon(txt, "npicard", s.npicard);
+    canon(txt, "tolpicard", s.tolpicard);
+    canon(txt, "enthalpy", s.enthalpy);
+    //the states of a sequenced trial come from the coarse grid until tseq
+    if (s.tseq > 0.0) {
+        canon(txt, "tseq", s.tseq);
+        canon(txt, "seqx", s.seqx);
+        canon(txt, "seqz", s.seqz);
+        canon(txt, "tolseq", s.tolseq);
+    }
+
+    canon(txt, "Hdep0", s.Hdep0);
+    canon(txt, "Rmax", s.Rmax);
+    canon(txt, "poro0", s.poro0);
+    canon(txt, "porogam", s.porogam);
+    canon(txt, "perm0", s.perm0);
+    canon(txt, "permgam", s.permgam);
+    canon(txt, "kTr", s.kTr);
+    canon(txt, "fTgeo", s.fTgeo);
+    canon(txt, "Ts0", s.Ts0);
+    canon(txt, "Tsf", s.Tsf);
+    canon(txt, "Tsgam", s.Tsgam);
+    canon(txt, "TsLR", s.TsLR);
+
+    return(txt);
+}
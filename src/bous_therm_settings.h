@@ -7,6 +7,7 @@
 #include <vector>
 #include <string>
 #include <string.h>
+#include <cstdio>
 
 //!container struct for all the settings variables needed for a BousThermModel run
 struct Settings {
@@ -24,6 +25,104 @@ struct Settings {
     int nsnap;
     //!maximum length of output vectors (subsampled to accomodate)
     long unsigned nmaxout;
+    //!time stepping method, "trapz", "rkc", "lts", or "etd" (optional)
+    std::string integrator;
+    //!steps between spectral radius estimates for the rkc integrator (optional)
+    long nrho;
+    //!choose the step from the stability limits, with nstep setting the largest step (optional)
+    bool autodt;
+    //!safety factor applied to the stability limit when choosing the step (optional)
+    double dtsafe;
+    //!steps between estimates of the stability limit (optional)
+    long ndt;
+    //!advance the water table implicitly along x, after the explicit thermal step (optional)
+    bool implicitH;
+    //!number of time slices for parareal integration, 0 for serial time stepping (optional)
+    long nslice;
+    //!integrator of the coarse parareal propagator (optional)
+    std::string coarse;
+    //!steps of the coarse parareal propagator in each slice (optional)
+    long ncoarse;
+    //!most parareal iterations, 0 for as many as slices (optional)
+    long npara;
+    //!parareal convergence tolerance of the water table, its largest change at the slice ends in m (optional)
+    double tolparaH;
+    //!parareal convergence tolerance of the thermal state, its largest change at the slice ends in K (optional)
+    double tolparaT;
+    //!compare the parareal iterates with a serial fine solution (optional)
+    bool pararef;
+    //!most Picard iterations of the implicit water table solve (optional)
+    long npicard;
+    //!convergence tolerance of the Picard iterations, largest change of the water table (m) (optional)
+    double tolpicard;
+
+    //-------------------------------------
+    //parallel decomposition (optional)
+
+    //!number of thermal columns along x in each tile (0 picks automatically)
+    long tilenx;
+    //!number of rows in each tile for map-view domains (0 picks automatically)
+    long tileny;
+    //!print the OpenMP thread placement at startup
+    bool affinity;
+    //!run the time loop inside one persistent parallel region
+    bool persist;
+    //!number of steps between repartitions of tiles among threads (0 never repartitions)
+    long unsigned nrebal;
+    //!track and report the storage error of the thermal diagnostics
+    bool precval;
+    //!comma separated names of diagnostic fields written at each snap, or "all"
+    std::string diagout;
+    //!write the two-dimensional diagnostic fields of later snaps as delta encoded differences from the snap before
+    bool snapdelta;
+    //!number of snaps between fields written in full with delta encoding, 0 for only the first
+    long deltakey;
+    //!use enthalpy as the thermal state instead of temperature with an apparent heat capacity
+    bool enthalpy;
+    //!directory of the result cache, empty for no cache
+    std::string cache;
+    //!hard link cached results into the output directory instead of copying them
+    bool cachelink;
+    //!directory of the spin-up library, empty for no library
+    std::string spinup;
+    //!comma separated model times (in tunit) at which states are saved in the spin-up library
+    std::string spinsave;
+    //!model time (in tunit) at which a trial run on a coarsened grid switches to the real grid, 0 for no grid sequencing
+    double tseq;
+    //!number of horizontal cells merged into one on the coarsened grid
+    long seqx;
+    //!number of vertical cells merged into one on the coarsened grid
+    long seqz;
+    //!switch to the real grid early when the state changes by less than this over a tenth of the coarse phase, 0 to always wait until tseq
+    double tolseq;
+    //!comma separated names of physical parameters that the output vectors are differentiated by, empty for none
+    std::string sensitivity;
+    //!relative perturbation of the parameters for their sensitivities
+    double sensrel;
+    //!comma separated names of physical parameters to calibrate, empty for no calibration
+    std::string calib;
+    //!comma separated calibration targets, each "metric@time:value" with the time in tunit
+    std::string calibtarget;
+    //!most Nelder-Mead iterations of a calibration
+    long calibiter;
+    //!calibration stops when every vertex of the simplex is within this relative distance of the best
+    double calibtol;
+    //!relative size of the initial calibration simplex
+    double calibstep;
+    //!accumulate per-column statistics every step and write them at the end
+    bool stats;
+    //!number of bins in the water table depth histograms
+    long statbins;
+    //!water table depth at the bottom of the last histogram bin (m), deeper tables go in the last bin
+    double statdmax;
+    //!comma separated probe locations, each "x:depth" on a transect or "x:y:depth" on a map-view grid (m), empty for none
+    std::string probes;
+    //!number of steps between probe records
+    long probeevery;
+    //!comma separated events, each "aqbot@x:depth", "evap@x", or "totalevap@value", with y after x on a map-view grid, empty for none
+    std::string events;
+    //!what events trigger, a comma separated list of "snap" and "probe"
+    std::string eventdo;
 
     //-------------------------------------
     //physical parameters
@@ -66,7 +165,34 @@ bool cmp (const char *s1, const char *s2);
 //!converts a character to an integet
 long to_long(const char *val);
 
+//!checks whether a name is in a comma separated list, which may also be "all" or "none"
+/*!
+\param[in] list comma separated names
+\param[in] name name to look for
+*/
+bool in_list (const std::string &list, const char *name);
+
+//!finds a physical parameter in a Settings structure by name
+/*!
+\param[in] s settings
+\param[in] name name of the parameter, as in the settings file
+\return pointer to the parameter, or NULL if there's no physical parameter with the name
+*/
+double *physical_param (Settings &s, const std::string &name);
+
 //!parses a settings file and returns it in a Settings structure
 Settings parse_settings ( std::vector< std::vector< std::string > > sv );
 
+//!writes every setting that can change the results as "name = value" lines in a fixed order
+/*!
+Numbers are written with all their digits, so two settings files that parse to the same Settings give the same text no matter how the values were written, which settings were left at their defaults, or the order of the lines. The cache settings themselves are left out, and so are the settings that only change the speed or what's printed (tiling, affinity, the persistent team, rebalancing, and precision validation).
+*/
+std::string canonical_settings (const Settings &s);
+
+//!writes the settings that determine the model state at a given step, like canonical_settings()
+/*!
+These are the physical parameters, the integrator and its options, the thermal formulation, the step size, and the grid sequencing settings of sequenced trials. Settings that only change the output, the length of the integration, or the parallel decomposition are left out.
+*/
+std::string trajectory_settings (const Settings &s);
+
 #endif
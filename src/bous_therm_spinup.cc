@@ -0,0 +1,56 @@
+//! \file bous_therm_spinup.cc
+
+#include <sys/stat.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+
+#include "bous_therm_cache.h"
+#include "bous_therm_spinup.h"
+
+std::string spinup_key (const Settings &stg, const std::string &griddir, const std::string &build) {
+    //the same hash as the result cache, with fewer settings
+    return( cache_key("spinup\n" + trajectory_settings(stg), griddir, build) );
+}
+
+std::string spinup_entry (const Settings &stg, const std::string &key) {
+    std::string dir = stg.spinup + "/" + key;
+    mkdir(stg.spinup.c_str(), 0755);
+    if (mkdir(dir.c_str(), 0755) == 0)
+        std::ofstream((dir + "/settings.txt").c_str()) << trajectory_settings(stg);
+    return(dir);
+}
+
+unsigned long spinup_find (const std::string &dir, unsigned long nmax) {
+    unsigned long best = 0;
+    std::vector<std::string> files = list_files(dir);
+    for (unsigned i=0; i<files.size(); i++) {
+        //complete states are named state_<step>, temporary ones have a suffix
+        if (files[i].compare(0, 6, "state_") != 0) continue;
+        std::string num = files[i].substr(6);
+        if ( (num.length() == 0) || (num.find_first_not_of("0123456789") != std::string::npos) ) continue;
+        unsigned long n = std::strtoul(num.c_str(), NULL, 10);
+        if ( (n <= nmax) && (n > best) ) best = n;
+    }
+    return(best);
+}
+
+std::vector<unsigned long> spinup_steps (const Settings &stg, unsigned long n0) {
+    std::vector<unsigned long> steps;
+    double dt = stg.tend*stg.tunit/double(stg.nstep);
+    std::string list = stg.spinsave;
+    size_t i0 = 0, i1;
+    while (i0 < list.length()) {
+        i1 = list.find(',', i0);
+        if (i1 == std::string::npos) i1 = list.length();
+        //nearest step to each time
+        double t = std::atof(list.substr(i0, i1 - i0).c_str())*stg.tunit;
+        unsigned long n = (unsigned long)std::max(0.0, round(t/dt));
+        if ( (n > n0) && (n <= stg.nstep) ) steps.push_back(n);
+        i0 = i1 + 1;
+    }
+    std::sort(steps.begin(), steps.end());
+    steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+    return(steps);
+}
@@ -0,0 +1,47 @@
+#ifndef BOUS_THERM_SPINUP_H_
+#define BOUS_THERM_SPINUP_H_
+
+//! \file bous_therm_spinup.h
+
+/*!
+A library of model states for warm starting trials. Every trial starts from the same analytic profiles, so trials that share the settings determining the early transient (see trajectory_settings()) and the grid redo the same integration. With the `spinup` setting, states are saved at the `spinsave` times in an entry of the library named after the hash of those settings, the grid files, and the build, and a trial whose entry already holds states starts from the latest one it reaches and only integrates the rest. Each state is a file `state_<step>` written by BousThermModel::save_state(), and the entry also holds the trajectory settings in `settings.txt`.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bous_therm_settings.h"
+
+//!computes the name of a trial's entry in the spin-up library
+/*!
+\param[in] stg settings
+\param[in] griddir path to the grid directory, every regular file in it is hashed
+\param[in] build identifies the build of the model
+*/
+std::string spinup_key (const Settings &stg, const std::string &griddir, const std::string &build);
+
+//!creates a trial's entry in the spin-up library if it doesn't exist and returns its path
+/*!
+\param[in] stg settings
+\param[in] key name of the entry
+*/
+std::string spinup_entry (const Settings &stg, const std::string &key);
+
+//!finds the latest saved state in an entry, no later than a given step
+/*!
+\param[in] dir path to the entry
+\param[in] nmax last step of the trial
+\return step of the state, or 0 if there isn't one
+*/
+unsigned long spinup_find (const std::string &dir, unsigned long nmax);
+
+//!converts the spinsave times into steps, in increasing order
+/*!
+Only steps after n0 and no later than the last step of the trial are kept.
+\param[in] stg settings
+\param[in] n0 step the integration starts from
+*/
+std::vector<unsigned long> spinup_steps (const Settings &stg, unsigned long n0);
+
+#endif
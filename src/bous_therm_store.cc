@@ -0,0 +1,315 @@
+//! \file bous_therm_store.cc
+
+#include <sys/stat.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+
+#include "bous_therm_io.h"
+#include "bous_therm_settings.h"
+#include "bous_therm_cache.h"
+#include "bous_therm_store.h"
+
+//!a column of the store, its values for every trial in the sorted order
+struct StoreColumn {
+    //!name of the column
+    std::string name;
+    //!trial, setting, summary, or series
+    std::string kind;
+    //!i64, f64, or str
+    std::string type;
+    //!file name, without the extension
+    std::string file;
+    //!numbers, for the i64 and f64 columns
+    std::vector<double> num;
+    //!strings, for the str columns
+    std::vector<std::string> str;
+};
+
+//whether a string is a number, written to the value if it is
+static bool parse_number (const std::string &s, double *v) {
+    if (s.length() == 0) return(false);
+    char *end;
+    *v = strtod(s.c_str(), &end);
+    return(*end == '\0');
+}
+
+//writes a whole file, failing if it can't
+static void write_all (const std::string &fn, const void *p, size_t n) {
+    FILE *ofile = fopen(fn.c_str(), "wb");
+    if ( (ofile == NULL) || (fwrite(p, 1, n, ofile) != n) ) {
+        std::cout << "FAILURE: cannot write file " << fn << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fclose(ofile);
+}
+
+//writes a column in its type
+static void write_column (const std::string &dir, const StoreColumn &c) {
+    std::string fn = dir + "/" + c.file;
+    if (c.type == "str") {
+        std::string bytes;
+        std::vector<int64_t> off(1, 0);
+        for (unsigned i=0; i<c.str.size(); i++) {
+            bytes += c.str[i];
+            off.push_back(bytes.length());
+        }
+        write_all(fn + ".str", bytes.data(), bytes.length());
+        write_all(fn + ".off", off.data(), off.size()*sizeof(int64_t));
+    } else if (c.type == "i64") {
+        std::vector<int64_t> v(c.num.begin(), c.num.end());
+        write_all(fn + ".i64", v.data(), v.size()*sizeof(int64_t));
+    } else {
+        write_all(fn + ".f64", c.num.data(), c.num.size()*sizeof(double));
+    }
+}
+
+//adds the trial directories under a directory to a list
+static void walk_trials (const std::string &top, const std::string &rel, const std::string &fnset, std::vector<std::string> &trials) {
+    std::string dir = (rel == ".") ? top : top + "/" + rel;
+    std::vector<std::string> files = list_files(dir);
+    if ( std::binary_search(files.begin(), files.end(), fnset)
+      && std::binary_search(files.begin(), files.end(), std::string("o_t")) )
+        trials.push_back(rel);
+    std::vector<std::string> dirs = list_dirs(dir);
+    for (unsigned i=0; i<dirs.size(); i++)
+        walk_trials(top, (rel == ".") ? dirs[i] : rel + "/" + dirs[i], fnset, trials);
+}
+
+std::vector<std::string> find_trials (const std::string &top, const std::string &fnset) {
+    std::vector<std::string> trials;
+    walk_trials(top, ".", fnset, trials);
+    std::sort(trials.begin(), trials.end());
+    return(trials);
+}
+
+void write_store (const std::string &top, const std::vector<std::string> &trials, const std::string &fnset, const std::string &dir, long chunk) {
+
+    long ntrial = trials.size();
+    if (ntrial == 0) {
+        std::cout << "FAILURE: no trials to store, a trial directory needs " << fnset << " and o_t" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    auto path = [&] (long i) { return( (trials[i] == ".") ? top : top + "/" + trials[i] ); };
+
+    //--------------------------------------------------------------------------
+    //canonical settings of every trial, a column for each setting
+
+    std::vector<std::string> names;
+    std::vector< std::vector<std::string> > vals;
+    for (long i=0; i<ntrial; i++) {
+        std::string fn = path(i) + "/" + fnset;
+        Settings stg = parse_settings(read_settings_file(fn.c_str()));
+        std::string txt = canonical_settings(stg);
+        //"name = value" lines, in the same order for every trial
+        size_t i0 = 0, i1;
+        unsigned k = 0;
+        while ( (i1 = txt.find('\n', i0)) != std::string::npos ) {
+            std::string line = txt.substr(i0, i1 - i0);
+            size_t e = line.find(" = ");
+            if (i == 0) {
+                names.push_back(line.substr(0, e));
+                vals.push_back(std::vector<std::string>(ntrial));
+            }
+            vals[k++][i] = line.substr(e + 3);
+            i0 = i1 + 1;
+        }
+    }
+    long nset = names.size();
+
+    //type of each setting column and the settings that vary across the batch
+    std::vector< std::vector<double> > nums(nset, std::vector<double>(ntrial));
+    std::vector<std::string> types(nset);
+    std::vector<long> varying;
+    for (long k=0; k<nset; k++) {
+        bool isnum = true, isint = true, vary = false;
+        for (long i=0; i<ntrial; i++) {
+            double v = NAN;
+            if (isnum && parse_number(vals[k][i], &v)) {
+                if ( (v != floor(v)) || (fabs(v) > 9e15) ) isint = false;
+            } else {
+                isnum = false;
+            }
+            nums[k][i] = v;
+            if (vals[k][i] != vals[k][0]) vary = true;
+        }
+        types[k] = isnum ? (isint ? "i64" : "f64") : "str";
+        if (vary) varying.push_back(k);
+    }
+
+    //--------------------------------------------------------------------------
+    //sort the trials by the varying settings
+
+    std::vector<long> order(ntrial);
+    for (long i=0; i<ntrial; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](long a, long b) {
+        for (unsigned j=0; j<varying.size(); j++) {
+            long k = varying[j];
+            if (types[k] == "str") {
+                if (vals[k][a] != vals[k][b]) return(vals[k][a] < vals[k][b]);
+            } else {
+                if (nums[k][a] != nums[k][b]) return(nums[k][a] < nums[k][b]);
+            }
+        }
+        return(false);
+    });
+
+    //--------------------------------------------------------------------------
+    //output vectors that every trial wrote
+
+    std::vector<std::string> series;
+    for (long i=0; i<ntrial; i++) {
+        std::vector<std::string> files = list_files(path(i)), have;
+        for (unsigned j=0; j<files.size(); j++)
+            if (files[j].compare(0, 2, "o_") == 0) have.push_back(files[j].substr(2));
+        if (i == 0) {
+            series = have;
+        } else {
+            std::vector<std::string> both;
+            std::set_intersection(series.begin(), series.end(), have.begin(), have.end(), std::back_inserter(both));
+            series = both;
+        }
+    }
+    //time first, then the others in order
+    auto it = std::find(series.begin(), series.end(), std::string("t"));
+    if (it == series.end()) {
+        std::cout << "FAILURE: every trial needs o_t to be stored" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    series.erase(it);
+    series.insert(series.begin(), "t");
+    long nser = series.size();
+
+    //--------------------------------------------------------------------------
+    //columns of the trials and settings
+
+    mkdir(dir.c_str(), 0755);
+    std::vector<StoreColumn> cols;
+
+    StoreColumn ct;
+    ct.name = "trial";
+    ct.kind = "trial";
+    ct.type = "str";
+    ct.file = "trial";
+    for (long i=0; i<ntrial; i++) ct.str.push_back(trials[order[i]]);
+    cols.push_back(ct);
+
+    for (long k=0; k<nset; k++) {
+        StoreColumn c;
+        c.name = names[k];
+        c.kind = "setting";
+        c.type = types[k];
+        c.file = "set_" + names[k];
+        for (long i=0; i<ntrial; i++) {
+            if (types[k] == "str") c.str.push_back(vals[k][order[i]]);
+            else c.num.push_back(nums[k][order[i]]);
+        }
+        cols.push_back(c);
+    }
+
+    //--------------------------------------------------------------------------
+    //series, a chunk of trials at a time, and their summaries
+
+    std::vector<FILE*> fser(nser);
+    for (long s=0; s<nser; s++) {
+        std::string fn = dir + "/ser_" + series[s] + ".f64";
+        fser[s] = fopen(fn.c_str(), "wb");
+        if (fser[s] == NULL) {
+            std::cout << "FAILURE: cannot open file " << fn << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::vector<int64_t> offsets(1, 0);
+    //last, min, max, and time average of each vector but time, then the end time and length
+    const char *stat[4] = {"last", "min", "max", "mean"};
+    long nsum = 4*(nser - 1) + 2;
+    std::vector< std::vector<double> > sums(nsum, std::vector<double>(ntrial, NAN));
+
+    for (long c0=0; c0<ntrial; c0+=chunk) {
+        long c1 = std::min(ntrial, c0 + chunk);
+        for (long i=c0; i<c1; i++) {
+            std::string tdir = path(order[i]);
+            std::vector<double> t = read_double_vec(tdir + "/o_t");
+            long n = t.size();
+            for (long s=0; s<nser; s++) {
+                std::vector<double> v = (s == 0) ? t : read_double_vec(tdir + "/o_" + series[s]);
+                if (long(v.size()) != n) {
+                    std::cout << "FAILURE: o_" << series[s] << " and o_t have different lengths in " << tdir << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                if ( (n > 0) && (fwrite(v.data(), sizeof(double), n, fser[s]) != size_t(n)) ) {
+                    std::cout << "FAILURE: cannot write file " << dir << "/ser_" << series[s] << ".f64" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                if ( (s == 0) || (n == 0) ) continue;
+                long m = 4*(s - 1);
+                sums[m][i] = v[n-1];
+                sums[m+1][i] = *std::min_element(v.begin(), v.end());
+                sums[m+2][i] = *std::max_element(v.begin(), v.end());
+                //trapezoids over the output times
+                double area = 0.0;
+                for (long j=1; j<n; j++) area += 0.5*(v[j] + v[j-1])*(t[j] - t[j-1]);
+                sums[m+3][i] = (t[n-1] > t[0]) ? area/(t[n-1] - t[0]) : v[n-1];
+            }
+            if (n > 0) sums[nsum-2][i] = t[n-1];
+            sums[nsum-1][i] = double(n);
+            offsets.push_back(offsets.back() + n);
+        }
+    }
+    for (long s=0; s<nser; s++) fclose(fser[s]);
+    write_all(dir + "/ser_offsets.i64", offsets.data(), offsets.size()*sizeof(int64_t));
+
+    for (long m=0; m<nsum; m++) {
+        StoreColumn c;
+        if (m < nsum - 2) c.name = series[m/4 + 1] + "_" + stat[m%4];
+        else c.name = (m == nsum - 2) ? "t_end" : "nout";
+        c.kind = "summary";
+        c.type = (m == nsum - 1) ? "i64" : "f64";
+        c.file = "sum_" + c.name;
+        c.num = sums[m];
+        cols.push_back(c);
+    }
+
+    //--------------------------------------------------------------------------
+    //write the columns and the minimum and maximum of the numeric ones in each chunk
+
+    long nchunk = (ntrial + chunk - 1)/chunk, nzone = 0;
+    std::vector<double> zones;
+    for (long c0=0; c0<ntrial; c0+=chunk) {
+        long c1 = std::min(ntrial, c0 + chunk);
+        nzone = 0;
+        for (unsigned k=0; k<cols.size(); k++) {
+            if (cols[k].type == "str") continue;
+            double lo = NAN, hi = NAN;
+            for (long i=c0; i<c1; i++) {
+                lo = fmin(lo, cols[k].num[i]);
+                hi = fmax(hi, cols[k].num[i]);
+            }
+            zones.push_back(lo);
+            zones.push_back(hi);
+            nzone++;
+        }
+    }
+    write_all(dir + "/chunks.f64", zones.data(), zones.size()*sizeof(double));
+
+    FILE *fschema = fopen((dir + "/schema.txt").c_str(), "w");
+    if (fschema == NULL) {
+        std::cout << "FAILURE: cannot write file " << dir << "/schema.txt" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fschema, "# trials of %s, one row each, sorted by the varying settings\n", top.c_str());
+    fprintf(fschema, "ntrial %li\nchunk %li\nnchunk %li\nnzone %li\n", ntrial, chunk, nchunk, nzone);
+    fprintf(fschema, "varying");
+    for (unsigned j=0; j<varying.size(); j++) fprintf(fschema, " %s", names[varying[j]].c_str());
+    fprintf(fschema, "\n# name kind type file\n");
+    for (unsigned k=0; k<cols.size(); k++) {
+        write_column(dir, cols[k]);
+        fprintf(fschema, "column %s %s %s %s\n", cols[k].name.c_str(), cols[k].kind.c_str(), cols[k].type.c_str(), cols[k].file.c_str());
+    }
+    for (long s=0; s<nser; s++)
+        fprintf(fschema, "column %s series f64 ser_%s\n", series[s].c_str(), series[s].c_str());
+    fclose(fschema);
+}
@@ -0,0 +1,49 @@
+#ifndef BOUS_THERM_STORE_H_
+#define BOUS_THERM_STORE_H_
+
+//! \file bous_therm_store.h
+
+/*!
+A columnar store of the results of a batch of trials, so that an analysis of thousands of trials maps a few files into memory instead of opening every settings file and output vector. A store is a directory holding
+
+    schema.txt        the number of trials, the chunk size, the parameters that vary across the batch, and one line per column, "name kind type file"
+    <column>.i64/.f64 a column of integers or doubles, one value per trial
+    <column>.str/.off a column of strings, their bytes one after another and the int64 offsets of each trial's string (one more than the trials)
+    ser_offsets.i64   int64 offsets of each trial's output vectors in the series columns (one more than the trials)
+    chunks.f64        the minimum and maximum of every numeric setting and summary column in each chunk of trials
+
+The kinds of column are
+
+    trial    the trial directory, relative to the batch directory
+    setting  every setting that can change the results, as written by canonical_settings(), so trials that left a setting at its default still have its value
+    summary  the last value, minimum, maximum, and time average of each output vector, named like evap_last, and the end time and length of the output
+    series   the output vectors of every trial, one after another
+
+A setting column holds integers if every trial's value is a whole number, doubles if every value is a number, and strings otherwise. Output vectors that only some trials wrote are left out.
+
+The trials are sorted by the settings that vary across the batch, in the order of the canonical settings, so trials with the same leading parameters are next to each other. The chunks are runs of trials in that order, and their minima and maxima (`chunks.f64` has shape chunks, columns, 2, with the numeric setting and summary columns in the order of the schema) let a selection by parameter skip chunks without reading them. The series are written a chunk at a time, so the batch never has to fit in memory.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+//!finds the trials of a batch, the directories under it with a settings file and output vectors
+/*!
+\param[in] top path to the batch directory
+\param[in] fnset name of the settings files
+\return paths of the trial directories, relative to the batch directory, sorted
+*/
+std::vector<std::string> find_trials (const std::string &top, const std::string &fnset);
+
+//!gathers the settings and output vectors of trials into a columnar store
+/*!
+\param[in] top path to the batch directory
+\param[in] trials paths of the trial directories, relative to the batch directory
+\param[in] fnset name of the settings files
+\param[in] dir path to the store directory, created if needed
+\param[in] chunk number of trials in a chunk
+*/
+void write_store (const std::string &top, const std::vector<std::string> &trials, const std::string &fnset, const std::string &dir, long chunk);
+
+#endif
@@ -0,0 +1,51 @@
+//! \file collect_trials.cc
+
+/*
+Gathers the settings and output vectors of every trial in a batch into one
+columnar store (see bous_therm_store.h), which the Store class in
+scripts/output_tools/reading.py maps into memory. Run it with
+
+    ./bin/collect_trials.exe <batch directory> <store directory> [chunk [settings file name]]
+
+Every directory under the batch directory with a settings file (settings.txt
+by default) and an o_t file is a trial. The chunk is the number of trials
+between entries of the chunk index, 256 by default. The store is written over
+any store already in the directory.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bous_therm_store.h"
+
+//!store tool driver
+int main (int argc, char **argv) {
+
+    //--------------------------------------------------------------------------
+    //check input
+
+    if ( (argc < 3) || (argc > 5) ) {
+        std::cout << "FAILURE: collect_trials requires a batch directory and a store directory, then optionally the chunk size and the name of the settings files" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string top = argv[1], dir = argv[2];
+    long chunk = (argc > 3) ? atol(argv[3]) : 256;
+    std::string fnset = (argc > 4) ? argv[4] : "settings.txt";
+    if (chunk < 1) {
+        std::cout << "FAILURE: the chunk size must be a positive number of trials" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    //--------------------------------------------------------------------------
+    //find and store the trials
+
+    std::vector<std::string> trials = find_trials(top, fnset);
+    printf("%lu trials found in %s\n", trials.size(), top.c_str());
+    write_store(top, trials, fnset, dir, chunk);
+    printf("store written to %s\n", dir.c_str());
+
+    return(0);
+}
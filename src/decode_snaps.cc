@@ -0,0 +1,78 @@
+//! \file decode_snaps.cc
+
+/*
+Turns the delta encoded snaps of an output directory, written by bous_therm
+with the snapdelta setting, back into plain binary files. Run it with
+
+    ./bin/decode_snaps.exe <output directory>
+
+Every file named <field>_<snap> that starts with the delta encoding header is
+decoded, snap by snap, from the previous snap of the same field, and replaced
+by the plain array. Other files are left alone, so running it twice is
+harmless.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "bous_therm_io.h"
+#include "bous_therm_cache.h"
+
+//!decoding tool driver
+int main (int argc, char **argv) {
+
+    //--------------------------------------------------------------------------
+    //check input
+
+    if (argc != 2) {
+        std::cout << "FAILURE: decode_snaps requires an output directory" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string dir = argv[1];
+
+    //--------------------------------------------------------------------------
+    //group the snap files by field, in order
+
+    std::map< std::string, std::vector< std::pair<long,std::string> > > fields;
+    std::vector<std::string> files = list_files(dir);
+    for (unsigned i=0; i<files.size(); i++) {
+        size_t u = files[i].rfind('_');
+        if ( (u == std::string::npos) || (u + 1 == files[i].length()) ) continue;
+        std::string num = files[i].substr(u + 1);
+        if (num.find_first_not_of("0123456789") != std::string::npos) continue;
+        fields[files[i].substr(0, u)].push_back(std::make_pair(atol(num.c_str()), files[i]));
+    }
+
+    //--------------------------------------------------------------------------
+    //decode each field from its first snap on
+
+    long ndec = 0;
+    for (auto f=fields.begin(); f!=fields.end(); f++) {
+        std::vector< std::pair<long,std::string> > &snaps = f->second;
+        std::sort(snaps.begin(), snaps.end());
+        std::vector<unsigned char> ref, a;
+        int w;
+        for (unsigned i=0; i<snaps.size(); i++) {
+            std::string fn = dir + "/" + snaps[i].second;
+            if (!read_delta(fn, ref, a, &w)) break;
+            std::string tmp = fn + ".decoding";
+            FILE *ofile = fopen(tmp.c_str(), "wb");
+            if ( (ofile == NULL) || (fwrite(a.data(), 1, a.size(), ofile) != a.size()) ) {
+                std::cout << "FAILURE: cannot write file " << tmp << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            fclose(ofile);
+            rename(tmp.c_str(), fn.c_str());
+            ref.swap(a);
+            ndec++;
+        }
+    }
+    printf("%li snap files decoded in %s\n", ndec, dir.c_str());
+
+    return(0);
+}
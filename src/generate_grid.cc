@@ -0,0 +1,155 @@
+//! \file generate_grid.cc
+
+/*
+Generates the grid files read by BousThermGrid, doing the same thing as the
+generate_grid.py script in the top directory without its slow refinement and
+smoothing loops. The inputs are read from a grid settings file, which has the
+same format as the model settings file and the same inputs as the top of
+generate_grid.py (see grid_settings.txt). Run it with
+
+    ./bin/generate_grid.exe <grid settings file> <grid directory>
+
+The topography can also be cut directly out of an ENVI raster like
+data/gale-dichotomy-topo/Gale_dichotomy_topo.img, along one transect or along
+every transect in a file, in which case a grid is built for each transect in
+parallel, in subdirectories of the grid directory named after the transects.
+
+With Ny > 0 the grid is a map-view grid of Ny rows between ya and yb. Rows cut
+out of a raster are transects parallel to the given one, and rows of profile or
+flat topography are the same profile tilted across the rows by yslope. The
+horizontal cells are shared by the rows, refined wherever any row needs it.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "omp.h"
+#include "bous_therm_io.h"
+#include "bous_therm_settings.h"
+#include "bous_therm_gridgen.h"
+#include "bous_therm_envi.h"
+
+//!builds the horizontal and vertical cell edges for the topography of every row
+static void build_grid (const GridSettings &gs, const std::vector<TopoProfile> &rows, std::vector<double> &xe, std::vector<double> &ze, bool verbose) {
+
+    //variably spaced horizontal grid, with the edges of every row's
+    //refinement, which all bisect the same starting intervals
+    xe.clear();
+    for (unsigned long r=0; r<rows.size(); r++) {
+        std::vector<double> xr = refine_grid(gs.xa, gs.xb, gs.Nx0, gs.zdepth, rows[r], gs.G0, gs.G1, gs.G2), xu;
+        std::set_union(xe.begin(), xe.end(), xr.begin(), xr.end(), std::back_inserter(xu));
+        xe.swap(xu);
+    }
+    if (verbose) printf("  refined to %lu cells\n", xe.size() - 1);
+    if (gs.smooth) {
+        xe = smooth_grid(xe);
+        if (verbose) printf("  smoothed to %lu cells\n", xe.size() - 1);
+    }
+    //vertical grid
+    ze = depth_edges(gs.zdepth, gs.delz0, gs.fdelz);
+}
+
+//!grid generation driver
+int main (int argc, char **argv) {
+
+    //--------------------------------------------------------------------------
+    //check input
+
+    if ( argc < 3 ) {
+        std::cout << "FAILURE: generate_grid requires two command line inputs\n  1) path to grid settings file\n  2) path to grid directory\nAt least one of these inputs was missing." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string fnset = argv[1], griddir = argv[2];
+
+    //--------------------------------------------------------------------------
+    //read settings
+
+    std::cout << "reading from grid settings file: " << fnset << std::endl;
+    GridSettings gs = parse_grid_settings( read_settings_file(fnset.c_str()) );
+
+    //--------------------------------------------------------------------------
+    //topography from profile files or a single transect
+
+    if (gs.fntransects.length() == 0) {
+        TopoProfile f;
+        std::vector<TopoProfile> rows;
+        std::vector<double> ye;
+        if (gs.fnenvi.length() > 0) {
+            std::cout << "reading topography from raster " << gs.fnenvi << std::endl;
+            EnviRaster r(gs.fnenvi);
+            Transect t = {"", gs.te0, gs.tn0, gs.te1, gs.tn1};
+            std::vector<double> x, z;
+            f = transect_profile(r, gs, t, x, z);
+            printf("  %s transect of %ld points, %g m long\n", gs.tpath.c_str(), gs.tnpts, x.back() - x.front());
+            rows = grid_rows(gs, &r, t, f, ye);
+        } else {
+            if (gs.fnxtopo.length() > 0) {
+                std::cout << "reading topography from " << gs.fnxtopo << " and " << gs.fnztopo << std::endl;
+                f = TopoProfile(read_double_vec(gs.fnxtopo), read_double_vec(gs.fnztopo));
+            } else {
+                std::cout << "using flat topography" << std::endl;
+            }
+            Transect t = {"", 0.0, 0.0, 0.0, 0.0};
+            rows = grid_rows(gs, NULL, t, f, ye);
+        }
+
+        std::cout << "generating grid..." << std::endl;
+        double tic = omp_get_wtime();
+        std::vector<double> xe, ze;
+        build_grid(gs, rows, xe, ze, true);
+        printf("  grid generated in %g sec\n", omp_get_wtime() - tic);
+
+        //print some info
+        double dxmin = INFINITY;
+        for (unsigned long j=0; j<xe.size()-1; j++) dxmin = std::min(dxmin, xe[j+1] - xe[j]);
+        printf("  Nx = %5lu, minimum x spacing fraction: %g\n", xe.size() - 1, dxmin/(gs.xb - gs.xa));
+        printf("  Nz = %5lu, minimum z spacing fraction: %g\n", ze.size() - 1, (ze.back() - ze[ze.size()-2])/gs.zdepth);
+        if (gs.Ny > 0) printf("  Ny = %5li, row spacing: %g m\n", gs.Ny, ye[1] - ye[0]);
+
+        std::cout << "writing files..." << std::endl;
+        write_grid(griddir, xe, ze, ye, rows);
+        std::cout << "grid files are in the \"" << griddir << "\" directory" << std::endl;
+
+        return(0);
+    }
+
+    //--------------------------------------------------------------------------
+    //a grid for every transect in a file
+
+    if (gs.fnenvi.length() == 0) {
+        std::cout << "FAILURE: fntransects requires a raster in fnenvi" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "reading topography from raster " << gs.fnenvi << std::endl;
+    EnviRaster r(gs.fnenvi);
+    std::vector<Transect> tr = read_transects(gs.fntransects);
+    printf("generating %lu grids from transects in %s...\n", tr.size(), gs.fntransects.c_str());
+    mkdir(griddir.c_str(), 0755);
+    double tic = omp_get_wtime();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (long i=0; i<long(tr.size()); i++) {
+        //profile and grid
+        std::vector<double> x, z, xe, ze, ye;
+        TopoProfile f = transect_profile(r, gs, tr[i], x, z);
+        std::vector<TopoProfile> rows = grid_rows(gs, &r, tr[i], f, ye);
+        build_grid(gs, rows, xe, ze, false);
+        //grid files and the sampled profile
+        std::string dir = griddir + '/' + tr[i].name;
+        write_grid(dir, xe, ze, ye, rows);
+        write_double_vec(dir + '/' + "topo_x", x);
+        write_double_vec(dir + '/' + "topo_z", z);
+        #pragma omp critical
+        printf("  %-16s Nx = %5lu, Nz = %5lu\n", tr[i].name.c_str(), xe.size() - 1, ze.size() - 1);
+    }
+
+    printf("  grids generated in %g sec\n", omp_get_wtime() - tic);
+    std::cout << "grid files are in subdirectories of the \"" << griddir << "\" directory" << std::endl;
+
+    return(0);
+}
@@ -11,7 +11,7 @@ Setup
 Before the model can be run:
     1. Download and build [`libode`](https://github.com/wordsworthgroup/libode), a library of C++ integrators. A second-order explicit method is used by `bous_therm` by default. Information about how to compile `libode` can be found in its readme and documentation files. The library is small and self-contained (no dependencies), so it should be straightforward to build.
     2. Copy the `_config.mk` file in the top `bous_therm` directory to `config.mk` and change any compiler settings in the file to your specifications. In that file, the `odepath` variable should indicate where the top `libode` directory is. Then simply run `make` in the top `bous_therm` directory. If `libode` has been compiled, all the necessary linking is done in the makefile. Your compiler must have openmp.
-    4. Edit the inputs/settings section of the `generate_grid.py` script, then run it to create the grid files needed by the model. The script can be configured to read binary files with whatever model topography is desired.
+    4. Edit the inputs/settings section of the `generate_grid.py` script, then run it to create the grid files needed by the model. The script can be configured to read binary files with whatever model topography is desired. The same grids are generated much faster by `./bin/generate_grid.exe <grid settings file> <grid directory>`, which is built by `make` and reads the same inputs from a settings file like `grid_settings.txt`.
     5. Create a settings file or another file that will contain the model run settings. There should be a working file named `settings.txt` in the `bous_therm` repository, but the settings file can have any name.
 
 Now the model is compiled, the grid files are written, and a settings file is prepared. Next, create a directory for model output and run the model with
@@ -28,12 +28,18 @@ The model produces a slew of binary files. These can be read and plotted with th
 Structure
 ---------
 
-The top-level modeling functions are implemented in the BousThermModel class. It initializes the water table and temperature profiles, computes time derivatives as they're seen by the inherited ODE solver, and writes output files. Below this class, the BousThermNumerics class contains some functions for numerical tasks. The Numerics class also inherits from an ODE solving class in [`libode`](https://github.com/wordsworthgroup/libode). Further below, the BousThermGrid class is simply a container for grid variables which are read from files upon construction. Several static physical parameters and functions for other physical parameters are defined in bous_therm_param.h.
+The top-level modeling functions are implemented in the BousThermModel class. It initializes the water table and temperature profiles, computes time derivatives as they're seen by the inherited ODE solver, and writes output files. Below this class, the BousThermNumerics class contains some functions for numerical tasks. The Numerics class also inherits from an ODE solving class in [`libode`](https://github.com/wordsworthgroup/libode). Further below, the BousThermGrid class is simply a container for grid variables which are read from files upon construction. The grid is normally a transect, but if the grid directory also has `Ny.txt`, `ye`, `yc`, and `dely` files (and row-by-row topography), which `generate_grid.exe` writes when its `Ny` setting is positive, the model runs a map-view domain of Ny coupled rows. Either way, the columns are split into tiles that are shared between threads. Several static physical parameters and functions for other physical parameters are defined in bous_therm_param.h.
 
 A few other modules support the main model classes.
 + bous_therm_io.h: functions for reading and writing files
 + bous_therm_util.h: miscellaneous useful functions
 + bous_therm_settings.h: definition of the Settings structure
++ bous_therm_parareal.h: parareal integration in concurrent time slices
++ bous_therm_cache.h: a content addressed cache of results, so repeated trials are copied instead of run
++ bous_therm_spinup.h: a library of saved states for warm starting trials
++ bous_therm_sequence.h: grid sequencing, running the early part of a trial on a coarsened grid
++ bous_therm_calibrate.h: calibration of physical parameters to target outputs, with many trials in process
++ bous_therm_store.h: a columnar store of the results of a batch of trials, written by `collect_trials.exe` for analysis
 */
 
 #include <iostream>
@@ -46,6 +52,51 @@ A few other modules support the main model classes.
 #include "bous_therm_util.h"
 #include "bous_therm_settings.h"
 #include "bous_therm_model.h"
+#include "bous_therm_parareal.h"
+#include "bous_therm_cache.h"
+#include "bous_therm_spinup.h"
+#include "bous_therm_sequence.h"
+#include "bous_therm_calibrate.h"
+
+//the makefile passes the git revision and a checksum of the sources and
+//compile flags, which identify the build in cache keys
+#ifndef BUILD_VERSION
+#define BUILD_VERSION "unknown"
+#endif
+static const char *build_version = BUILD_VERSION;
+
+//!prints where the OpenMP threads are bound
+/*!
+Pinning is controlled by the usual environment variables, for example `OMP_PLACES=cores` and `OMP_PROC_BIND=spread` to spread threads across sockets. The report shows whether the binding took effect, which matters because every thread works on the columns whose memory it touched first.
+*/
+void print_affinity () {
+
+    //the environment as the runtime sees it
+    const char *places = getenv("OMP_PLACES");
+    const char *bind = getenv("OMP_PROC_BIND");
+    printf("OMP_PLACES = %s\n", places ? places : "(unset)");
+    printf("OMP_PROC_BIND = %s\n", bind ? bind : "(unset)");
+    printf("omp places: %d\n", omp_get_num_places());
+    if (omp_get_proc_bind() == omp_proc_bind_false) {
+        printf("threads are not bound to places\n");
+        return;
+    }
+    //report each thread's place and the processors in it
+    #pragma omp parallel
+    {
+        int p = omp_get_place_num();
+        int n = 0;
+        if (p >= 0) n = omp_get_place_num_procs(p);
+        std::vector<int> ids(n > 0 ? n : 1);
+        if (n > 0) omp_get_place_proc_ids(p, ids.data());
+        #pragma omp critical
+        {
+            printf("  thread %3d -> place %3d, procs", omp_get_thread_num(), p);
+            for (int i=0; i<n; i++) printf(" %d", ids[i]);
+            printf("\n");
+        }
+    }
+}
 
 //!model driver
 int main (int argc, char **argv) {
@@ -80,6 +131,54 @@ int main (int argc, char **argv) {
     //parse the settings into the struct
     Settings stg = parse_settings(sv);
     std::cout << "settings parsed" << std::endl;
+    //report thread placement if desired
+    if (stg.affinity) print_affinity();
+
+    //--------------------------------------------------------------------------
+    //look for the results in the cache
+
+    std::string key, canon;
+    time_t tstart = time(NULL);
+    if (stg.cache.length() > 0) {
+        canon = canonical_settings(stg);
+        key = cache_key(canon, dirgrid, build_version);
+        printf("cache key: %s\n", key.c_str());
+        if (cache_fetch(stg.cache, key, dirout, stg.cachelink)) {
+            printf("results found in the cache, %s into %s\n", stg.cachelink ? "linked" : "copied", dirout.c_str());
+            std::cout << "\nmain finished\n-------------\n" << std::endl;
+            return(0);
+        }
+        printf("results not in the cache\n");
+    }
+    //output files linked from a cache entry are written as copies, leaving the entry alone
+    long nshared = unshare_files(dirout);
+    if (nshared > 0) printf("%li output files linked from elsewhere were replaced by copies\n", nshared);
+
+    //--------------------------------------------------------------------------
+    //calibration sets the parameters for the rest of the trial
+
+    if (stg.calib.length() > 0) calibrate(dirgrid, &stg, dirout.c_str());
+
+    //--------------------------------------------------------------------------
+    //parareal integration builds its own models
+
+    if (stg.nslice > 0) {
+        if (stg.spinup.length() > 0) printf("the spin-up library isn't used with parareal integration\n");
+        if (stg.tseq > 0.0) printf("grid sequencing isn't used with parareal integration\n");
+        if (stg.sensitivity.length() > 0) printf("sensitivities aren't computed with parareal integration\n");
+        if (stg.stats) printf("statistics aren't accumulated with parareal integration\n");
+        stg.stats = false;
+        if (stg.probes.length() > 0) printf("probes aren't recorded with parareal integration\n");
+        stg.probes = "";
+        if (stg.events.length() > 0) printf("events aren't detected with parareal integration\n");
+        stg.events = "";
+        std::cout << "output directory: " << dirout << std::endl;
+        solve_parareal(dirgrid, &stg, dirout.c_str());
+        printf("trial complete\n");
+        if (key.length() > 0) cache_store(stg.cache, key, dirout, tstart, canon, dirgrid, build_version);
+        std::cout << "\nmain finished\n-------------\n" << std::endl;
+        return(0);
+    }
 
     //--------------------------------------------------------------------------
     //instantiate the model
@@ -92,13 +191,83 @@ int main (int argc, char **argv) {
     double tend_sec = stg.tend*stg.tunit;
 
     std::cout << "output directory: " << dirout << std::endl;
-    printf("integrating for %g seconds (%g yr), %lu steps, %d snaps\n",
-        tend_sec, tend_sec/YEAR_SEC, stg.nstep, stg.nsnap);
+    //automatic steps work with the trapezoidal method, local time stepping,
+    //and exponential time differencing, the persistent team only with the
+    //trapezoidal method
+    bool trapz = cmp(stg.integrator.c_str(), "trapz");
+    bool lts = cmp(stg.integrator.c_str(), "lts");
+    bool etd = cmp(stg.integrator.c_str(), "etd");
+    if (stg.autodt && !trapz && !lts && !etd) printf("autodt is ignored by the %s integrator\n", stg.integrator.c_str());
+    if (stg.persist && !trapz) printf("persist is ignored by the %s integrator\n", stg.integrator.c_str());
+    bool autodt = stg.autodt && (trapz || lts || etd), persist = stg.persist && trapz;
+
+    //warm start from the latest state in the spin-up library, which only
+    //holds states of fixed steps
+    if (stg.spinup.length() > 0) {
+        if (autodt || persist) printf("autodt and persist are ignored with the spin-up library\n");
+        autodt = persist = false;
+        std::string spindir = spinup_entry(stg, spinup_key(stg, dirgrid, build_version));
+        unsigned long n0 = spinup_find(spindir, stg.nstep);
+        if (n0 > 0) {
+            mod.load_state(spindir + "/state_" + std::to_string(n0));
+            printf("warm start from the spin-up state after step %lu (%g yr)\n", n0, mod.get_t()/YEAR_SEC);
+        } else {
+            printf("no spin-up state to start from in %s\n", spindir.c_str());
+        }
+        //states to save, skipping those already saved
+        std::vector<unsigned long> steps = spinup_steps(stg, n0);
+        for (unsigned i=0; i<steps.size(); i++)
+            if (!file_exists(spindir, ("state_" + std::to_string(steps[i])).c_str()))
+                mod.spinsteps.push_back(steps[i]);
+        mod.spindir = spindir;
+    }
+
+    //run the early part on a coarsened grid, unless it was warm started
+    if (stg.tseq > 0.0) {
+        if (mod.resumed) printf("grid sequencing is skipped for a warm start\n");
+        else sequence_grid(mod, dirgrid, &stg, dirout);
+    }
+
+    //derivatives by parameters, which start from the initial state and are
+    //advanced after every step on the main thread
+    if (stg.sensitivity.length() > 0) {
+        if (mod.resumed) {
+            printf("sensitivities aren't computed for a warm start or after grid sequencing\n");
+        } else {
+            if (persist) printf("persist is ignored with sensitivities\n");
+            persist = false;
+            mod.init_sensitivity(dirgrid);
+        }
+    }
+
+    //statistics start with the integration on the real grid
+    if (stg.stats && mod.resumed) printf("statistics cover the integration from %g yr\n", mod.get_t()/YEAR_SEC);
+
+    if (autodt) {
+        //steps come from the stability limits, nstep only caps them
+        printf("integrating for %g seconds (%g yr), at least %lu steps, %d snaps\n",
+            tend_sec, tend_sec/YEAR_SEC, stg.nstep, stg.nsnap);
+        mod.update_diagnostics();
+        double dt0 = mod.stable_dt();
+        if (lts || etd) dt0 = mod.dtlim_H;
+        printf("initial stable step is %g sec\n", stg.dtsafe*dt0);
+        mod.print_stable_dt();
+    } else {
+        printf("integrating for %g seconds (%g yr), %lu steps, %d snaps\n",
+            tend_sec, tend_sec/YEAR_SEC, stg.nstep, stg.nsnap);
+    }
+    if (persist) printf("running the time loop in a persistent thread team\n");
     std::cout << std::endl;
 
-    mod.solve_fixed(tend_sec, tend_sec/double(stg.nstep), stg.nsnap, dirout.c_str());
+    //a warm start or a switch from the coarsened grid integrates the rest in
+    //the time loop, which starts at the current time and lands on the end
+    if (autodt || persist || mod.resumed)
+        mod.solve_loop(tend_sec - mod.get_t(), tend_sec/double(stg.nstep), stg.nsnap, dirout.c_str(), autodt, persist);
+    else
+        mod.solve_fixed(tend_sec, tend_sec/double(stg.nstep), stg.nsnap, dirout.c_str());
 
     printf("trial complete\n");
+    if (key.length() > 0) cache_store(stg.cache, key, dirout, tstart, canon, dirgrid, build_version);
 
     //--------------------------------------------------------------------------
     //finish
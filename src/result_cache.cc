@@ -0,0 +1,129 @@
+//! \file result_cache.cc
+
+/*
+Lists, verifies, and evicts the entries of a result cache, the directory given
+by the cache setting of bous_therm (see bous_therm_cache.h). Run it with
+
+    ./bin/result_cache.exe <cache directory> list
+    ./bin/result_cache.exe <cache directory> verify [remove]
+    ./bin/result_cache.exe <cache directory> evict size <limit>
+    ./bin/result_cache.exe <cache directory> evict age <days>
+
+Verifying checks the size and hash of every cached file and, with "remove",
+deletes the entries that fail. Evicting by size deletes the least recently used
+entries until the cached files take no more than the limit, in bytes with an
+optional K, M, G, or T suffix. Evicting by age deletes the entries that haven't
+been used for more than the given number of days. Both also delete temporary
+entries left for more than a day by trials that stopped while storing.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+
+#include "bous_therm_cache.h"
+
+//!parses a size like 500M or 2.5G into bytes
+static double parse_size (const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    switch (*end) {
+        case 'k': case 'K': v *= 1e3; break;
+        case 'm': case 'M': v *= 1e6; break;
+        case 'g': case 'G': v *= 1e9; break;
+        case 't': case 'T': v *= 1e12; break;
+    }
+    return(v);
+}
+
+//!formats a time like 2026-10-19 14:03
+static std::string fmt_time (time_t t) {
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", localtime(&t));
+    return(std::string(buf));
+}
+
+//!cache tool driver
+int main (int argc, char **argv) {
+
+    //--------------------------------------------------------------------------
+    //check input
+
+    std::string cmd = (argc > 2) ? argv[2] : "";
+    if ( (cmd != "list") && (cmd != "verify") && (cmd != "evict") ) {
+        std::cout << "FAILURE: result_cache requires a cache directory and a command\n  list\n  verify [remove]\n  evict size <limit>\n  evict age <days>" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string dir = argv[1];
+    std::vector<CacheEntry> entries = cache_entries(dir);
+
+    //--------------------------------------------------------------------------
+    //list the entries, least recently used first
+
+    if (cmd == "list") {
+        double total = 0.0;
+        printf("%-32s %6s %10s  %-16s  %-16s\n", "key", "files", "MB", "created", "used");
+        for (unsigned i=0; i<entries.size(); i++) {
+            printf("%-32s %6li %10.3f  %-16s  %-16s\n", entries[i].key.c_str(), entries[i].nfile,
+                double(entries[i].size)/1e6, fmt_time(entries[i].created).c_str(), fmt_time(entries[i].used).c_str());
+            total += double(entries[i].size);
+        }
+        printf("%lu entries, %.3f MB\n", entries.size(), total/1e6);
+    }
+
+    //--------------------------------------------------------------------------
+    //check every file against the manifests
+
+    if (cmd == "verify") {
+        bool remove = (argc > 3) && (std::string(argv[3]) == "remove");
+        long nbad = 0;
+        for (unsigned i=0; i<entries.size(); i++) {
+            std::string msg;
+            if (cache_verify(dir, entries[i].key, msg)) continue;
+            nbad++;
+            printf("%s: %s%s\n", entries[i].key.c_str(), msg.c_str(), remove ? ", removed" : "");
+            if (remove) cache_remove(dir, entries[i].key);
+        }
+        printf("%li of %lu entries failed verification\n", nbad, entries.size());
+    }
+
+    //--------------------------------------------------------------------------
+    //evict by total size or by age
+
+    if (cmd == "evict") {
+        std::string by = (argc > 3) ? argv[3] : "";
+        if ( ((by != "size") && (by != "age")) || (argc < 5) ) {
+            std::cout << "FAILURE: evict requires \"size <limit>\" or \"age <days>\"" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        long nrm = 0;
+        double freed = 0.0;
+        if (by == "size") {
+            double limit = parse_size(argv[4]), total = 0.0;
+            for (unsigned i=0; i<entries.size(); i++) total += double(entries[i].size);
+            //least recently used go first
+            for (unsigned i=0; (i<entries.size()) && (total > limit); i++) {
+                cache_remove(dir, entries[i].key);
+                total -= double(entries[i].size);
+                freed += double(entries[i].size);
+                nrm++;
+            }
+        } else {
+            double age = std::atof(argv[4])*86400.0;
+            time_t now = time(NULL);
+            for (unsigned i=0; i<entries.size(); i++) {
+                if (difftime(now, entries[i].used) <= age) continue;
+                cache_remove(dir, entries[i].key);
+                freed += double(entries[i].size);
+                nrm++;
+            }
+        }
+        long ntmp = cache_clean(dir, 86400.0);
+        printf("evicted %li of %lu entries (%.3f MB) and %li temporary entries\n",
+            nrm, entries.size(), freed/1e6, ntmp);
+    }
+
+    return(0);
+}